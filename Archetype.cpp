@@ -0,0 +1,75 @@
+/*
+* Archetype.cpp, 10/19/2026 7:10 PM
+*/
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/* Immutable metadata shared by all the entities of a type, the type is identified
+   by the address of the entity's internal object. An archetype is completed by the
+   entity which decoded it before it is inserted in the table, and never modified
+   after. */
+class Archetype {
+public:
+
+    addrtype internal;
+    wstring path;
+    unsigned int category = 0;
+    bool is_valid = false;
+
+    /* component names and their indices in the entity's component list */
+    std::vector<std::pair<string, int>> components;
+    int positioned_index = -1;
+    bool is_walked = false;     /* the layout is known, even if the type has no components */
+
+    Archetype(addrtype internal) : internal(internal) {
+    }
+};
+
+/* Archetypes by internal address, the type objects are released with the area,
+   so the table is cleared on area change. */
+class ArchetypeTable {
+protected:
+
+    std::unordered_map<addrtype, shared_ptr<Archetype>> archetypes;
+    std::mutex mutex;
+
+public:
+
+    shared_ptr<Archetype> find(addrtype internal) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = archetypes.find(internal);
+        return (i != archetypes.end()) ? i->second : nullptr;
+    }
+
+    /* keeps the first archetype if another thread decoded the same type. */
+    void insert(shared_ptr<Archetype>& archetype) {
+        std::lock_guard<std::mutex> lock(mutex);
+        archetypes.insert(std::make_pair(archetype->internal, archetype));
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return archetypes.size();
+    }
+
+    std::vector<shared_ptr<Archetype>> get_all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<shared_ptr<Archetype>> result;
+
+        for (auto& i : archetypes)
+            result.push_back(i.second);
+        return result;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        archetypes.clear();
+    }
+};
+
+/* Global archetype table */
+ArchetypeTable entity_archetypes;
@@ -0,0 +1,93 @@
+/*
+* AreaCache.cpp, 10/19/2026 11:05 PM
+*/
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/* Decoded entity metadata of an area instance, kept when the player leaves it. */
+struct AreaRecord {
+    int area_hash;
+    std::vector<shared_ptr<Archetype>> archetypes;
+    std::unordered_map<int, Point> positions;       /* last known grid positions by id */
+    std::vector<int> ignored_ids;
+};
+
+/* Bounded LRU of the areas visited recently. Returning to one of them, e.g. from
+   the hideout back to a map, restores the archetypes, categories and ignored ids
+   instead of decoding every entity type again. */
+class AreaCache : public PoEMemory {
+protected:
+
+    std::list<AreaRecord> records;          /* most recently used first */
+
+public:
+
+    int capacity = 8;
+    int restored = 0;                       /* archetypes restored by the last restore() */
+
+    void clear() {
+        records.clear();
+    }
+
+    void save(int area_hash, EntitySet& entities, InGameData* in_game_data) {
+        if (!area_hash)
+            return;
+
+        for (auto i = records.begin(); i != records.end(); ++i) {
+            if (i->area_hash == area_hash) {
+                records.erase(i);
+                break;
+            }
+        }
+
+        AreaRecord record;
+        record.area_hash = area_hash;
+        for (auto& i : entity_archetypes.get_all()) {
+            if (i->is_valid)
+                record.archetypes.push_back(i);
+        }
+        for (auto& i : entities.all) {
+            if (i.second->positioned)
+                record.positions[i.first] = i.second->pos;
+        }
+        if (in_game_data)
+            in_game_data->get_ignored_entities().for_each([&](int id) {record.ignored_ids.push_back(id);});
+
+        records.push_front(std::move(record));
+        if (records.size() > capacity)
+            records.pop_back();
+    }
+
+    /* Restores the metadata of the area, the archetypes whose type object was
+       replaced are dropped. Returns false if the area is not cached. */
+    bool restore(int area_hash, InGameData* in_game_data) {
+        restored = 0;
+        for (auto i = records.begin(); i != records.end(); ++i) {
+            if (i->area_hash != area_hash)
+                continue;
+
+            records.splice(records.begin(), records, i);
+            for (auto& archetype : i->archetypes) {
+                wstring path = PoEMemory::read<wstring>(archetype->internal + 0x8);
+                if (path != archetype->path)
+                    continue;
+
+                entity_archetypes.insert(archetype);
+                entity_classifier.insert(archetype->internal, archetype->category);
+                restored++;
+            }
+
+            FlatSet<int>& ignored = in_game_data->get_ignored_entities();
+            ignored.reserve(ignored.size() + i->ignored_ids.size());
+            for (int id : i->ignored_ids)
+                ignored.insert(id);
+            in_game_data->set_known_positions(i->positions);
+
+            return true;
+        }
+
+        return false;
+    }
+};
@@ -0,0 +1,119 @@
+/*
+* Camera.cpp, 10/19/2026 8:40 PM
+*/
+
+#include <emmintrin.h>
+
+struct Matrix4x4 {
+    float M[4][4];
+
+    float* operator[] (int index) {
+        return M[index];
+    }
+};
+
+/* Camera state needed to project world positions to the screen. */
+struct Camera {
+    Point size;                 /* width and height of the game window */
+    Matrix4x4 matrix;
+};
+
+Vector3& project(const Camera& camera, Vector3& vec) {
+    const float (*mat)[4] = camera.matrix.M;
+    float x = vec.x * mat[0][0] + vec.y * mat[1][0] + vec.z * mat[2][0] + mat[3][0];
+    float y = vec.x * mat[0][1] + vec.y * mat[1][1] + vec.z * mat[2][1] + mat[3][1];
+    float z = vec.x * mat[0][2] + vec.y * mat[1][2] + vec.z * mat[2][2] + mat[3][2];
+    float w = vec.x * mat[0][3] + vec.y * mat[1][3] + vec.z * mat[2][3] + mat[3][3];
+
+    vec.x = (1.0 + x / w) * camera.size.x / 2;
+    vec.y = (1.0 - y / w) * camera.size.y / 2;
+    vec.z = z / w;
+
+    return vec;
+}
+
+/* Projects n positions with SSE2, four at a time. The operations are done in the
+   same order and precision as project(), so the results are identical. */
+void project_batch(const Camera& camera, const Vector3* in, int n, Vector3* out) {
+    const float (*mat)[4] = camera.matrix.M;
+    __m128 m[4][4];
+    __m128d one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+    __m128d width = _mm_set1_pd(camera.size.x), height = _mm_set1_pd(camera.size.y);
+    int i = 0;
+
+    for (int r = 0; r < 4; ++r)
+        for (int c = 0; c < 4; ++c)
+            m[r][c] = _mm_set1_ps(mat[r][c]);
+
+    for (; i + 4 <= n; i += 4) {
+        const Vector3* v = in + i;
+        __m128 vx = _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x);
+        __m128 vy = _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y);
+        __m128 vz = _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z);
+        __m128 p[4];
+
+        for (int c = 0; c < 4; ++c) {
+            p[c] = _mm_add_ps(_mm_mul_ps(vx, m[0][c]), _mm_mul_ps(vy, m[1][c]));
+            p[c] = _mm_add_ps(p[c], _mm_mul_ps(vz, m[2][c]));
+            p[c] = _mm_add_ps(p[c], m[3][c]);
+        }
+
+        __m128 qx = _mm_div_ps(p[0], p[3]);
+        __m128 qy = _mm_div_ps(p[1], p[3]);
+        __m128 qz = _mm_div_ps(p[2], p[3]);
+
+        /* the screen coordinates are computed in double like the scalar path. */
+        __m128d x0 = _mm_cvtps_pd(qx), x1 = _mm_cvtps_pd(_mm_movehl_ps(qx, qx));
+        __m128d y0 = _mm_cvtps_pd(qy), y1 = _mm_cvtps_pd(_mm_movehl_ps(qy, qy));
+        x0 = _mm_div_pd(_mm_mul_pd(_mm_add_pd(one, x0), width), two);
+        x1 = _mm_div_pd(_mm_mul_pd(_mm_add_pd(one, x1), width), two);
+        y0 = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(one, y0), height), two);
+        y1 = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(one, y1), height), two);
+
+        float rx[4], ry[4], rz[4];
+        _mm_storeu_ps(rx, _mm_movelh_ps(_mm_cvtpd_ps(x0), _mm_cvtpd_ps(x1)));
+        _mm_storeu_ps(ry, _mm_movelh_ps(_mm_cvtpd_ps(y0), _mm_cvtpd_ps(y1)));
+        _mm_storeu_ps(rz, qz);
+        for (int k = 0; k < 4; ++k)
+            out[i + k] = {rx[k], ry[k], rz[k]};
+    }
+
+    for (; i < n; ++i) {
+        out[i] = in[i];
+        project(camera, out[i]);
+    }
+}
+
+/* Debug routine, projects n positions with each of the given number of
+   pseudo-random cameras through project() and project_batch(). Returns the
+   number of results which are not bit for bit identical. */
+int check_project_batch(int cameras = 100, int n = 103) {
+    std::vector<Vector3> in(n), out(n);
+    unsigned int seed = 1;
+    int mismatches = 0;
+
+    /* uniform in [-range, range), from a fixed linear congruential sequence */
+    auto random = [&](float range) {
+        seed = seed * 1103515245 + 12345;
+        return ((seed >> 8) / (float)(1 << 24) * 2 - 1) * range;
+    };
+
+    for (int k = 0; k < cameras; ++k) {
+        Camera camera = {{2560, 1440}};
+        for (int r = 0; r < 4; ++r)
+            for (int c = 0; c < 4; ++c)
+                camera.matrix.M[r][c] = random(10);
+        for (auto& v : in)
+            v = {random(30000), random(30000), random(300)};
+
+        project_batch(camera, in.data(), n, out.data());
+        for (int i = 0; i < n; ++i) {
+            Vector3 v = in[i];
+            project(camera, v);
+            if (memcmp(&v, &out[i], sizeof(Vector3)))
+                mismatches++;
+        }
+    }
+
+    return mismatches;
+}
@@ -6,6 +6,9 @@
 #include <unordered_map>
 #include <math.h>
 
+#include "EntityClassifier.cpp"
+#include "Archetype.cpp"
+
 FieldOffsets entity_offsets = {
     {"internal",        0x8},
         {"path",        0x8},
@@ -19,7 +22,6 @@ class Item;
 class Entity : public PoEObject {
 protected:
 
-    std::vector<string> component_names;
     std::unordered_map<string, shared_ptr<Component>> components;
 
     Component* read_component(const string& name, addrtype address) {
@@ -29,7 +31,25 @@ protected:
         return component;
     }
 
-    void get_all_components() {
+    shared_ptr<Archetype> get_archetype() {
+        addrtype internal = read<addrtype>("internal");
+        shared_ptr<Archetype> archetype = entity_archetypes.find(internal);
+        if (archetype)
+            return archetype;
+
+        /* new entity type, it is registered after its components were walked. */
+        archetype = shared_ptr<Archetype>(new Archetype(internal));
+        archetype->path = PoEMemory::read<wstring>(internal + (*offsets)["path"]);
+        archetype->is_valid = (archetype->path[0] == L'M');
+        if (archetype->is_valid)
+            archetype->category = entity_classifier.classify(internal, archetype->path);
+
+        return archetype;
+    }
+
+    /* Walk the component lookup of the entity type into the layout, returns true if
+       all the components are valid. */
+    bool get_all_components(std::vector<std::pair<string, int>>& layout, int& positioned_index) {
         addrtype component_list = read<addrtype>("component_list");
         addrtype component_lookup = PoEMemory::read<addrtype>(address + 0x8, {0x30, 0x30});
         addrtype component_entry = component_lookup;
@@ -50,12 +70,40 @@ protected:
 
             // Invalid component
             if (owner_address != address)
-                break;
-            
-            component_names.insert(component_names.end(), component_name);
+                return false;
+
+            if (component_name == "Positioned")
+                positioned_index = offset;
+            layout.push_back(std::make_pair(component_name, offset));
             std::shared_ptr<Component> component_ptr(read_component(component_name, addr));
             components.insert(std::make_pair(component_name, component_ptr));
         }
+
+        return true;
+    }
+
+    /* Read the components with the known layout of the entity type. */
+    void read_components() {
+        std::vector<addrtype> component_list;
+        int n = 0;
+
+        for (auto& i : archetype->components)
+            n = std::max(n, i.second + 1);
+        component_list.resize(n);
+        if (!n || !PoEMemory::read<addrtype>(read<addrtype>("component_list"), component_list.data(), n))
+            return;
+
+        /* The component list is allocated with the entity and replaced as a whole
+           when the entity is released, so the owner of one component is enough to
+           tell if the list still belongs to this entity. */
+        addrtype owner_address = PoEMemory::read<addrtype>(component_list[archetype->components[0].second] + 0x8);
+        if (owner_address != address)
+            return;
+
+        for (auto& i : archetype->components) {
+            std::shared_ptr<Component> component_ptr(read_component(i.first, component_list[i.second]));
+            components.insert(std::make_pair(i.first, component_ptr));
+        }
     }
 
     AhkObjRef* __get_component(const char* name) {
@@ -90,36 +138,57 @@ protected:
 public:
 
     wstring type_name;
-    wstring path;
+    shared_ptr<Archetype> archetype;
+    const wstring& path;
+    unsigned int category = 0;
     int id;
+    int slot = -1;
+    unsigned int generation = 0;
     bool is_valid = true;
     shared_ptr<Element> label;
     shared_ptr<Item> item;
+    Positioned* positioned = nullptr;
     Point pos;
 
     bool is_player = false;
     bool is_npc = false;
+    bool is_movable = false;
 
-    /* Monster related fields */
+    /* Monster related fields, rarity and neutrality differ between instances. */
     bool is_monster = false;
     bool is_neutral = false;
     int rarity = 0;
 
-    Entity(addrtype address) : PoEObject(address, &entity_offsets) {
-        path = read<wstring>("internal", "path");
-        if (path[0] != L'M') {
+    Entity(addrtype address)
+        : PoEObject(address, &entity_offsets), archetype(get_archetype()), path(archetype->path)
+    {
+        if (!archetype->is_valid) {
             this->is_valid = false;
             return;
         }
         id = read<int>("id");
+        category = archetype->category;
+
+        std::vector<std::pair<string, int>> layout;
+        int positioned_index = -1;
+        if (archetype->is_walked) {
+            read_components();
+        } else if (get_all_components(layout, positioned_index)) {
+            /* the archetype is still private to this entity, it is completed before
+               it is published to the other threads. */
+            archetype->components.swap(layout);
+            archetype->positioned_index = positioned_index;
+            archetype->is_walked = true;
+            entity_archetypes.insert(archetype);
+        }
 
-        get_all_components();
         is_player = has_component("Player");
         is_npc = has_component("NPC");
         is_monster = has_component("Monster");
+        is_movable = has_component("Actor");
+        positioned = get_component<Positioned>();
 
         if (is_monster) {
-            Positioned *positioned = get_component<Positioned>();
             is_neutral = positioned ? positioned->is_neutral() : false;
             ObjectMagicProperties* props = get_component<ObjectMagicProperties>();
             rarity = props ? props->rarity() : 0;
@@ -139,6 +208,8 @@ public:
               nullptr);
     }
 
+    /* Render names differ between instances of a type (e.g. rare monsters and
+       area transitions), so they are kept per entity. */
     virtual wstring& name() {
         if (type_name.empty()) {
             if (has_component("Render"))
@@ -196,10 +267,13 @@ public:
     }
 
     void list_components() {
-        for (string& name : component_names) {
-            std::cout << "\t";
-            components[name]->to_print();
-            std::cout << endl;
+        for (auto& i : archetype->components) {
+            auto component = components.find(i.first);
+            if (component != components.end()) {
+                std::cout << "\t";
+                component->second->to_print();
+                std::cout << endl;
+            }
         }
     }
 
@@ -224,13 +298,11 @@ public:
     wstring player_class;
     Life* life;
     Player* player;
-    Positioned* positioned;
     Actor* actor;
 
     LocalPlayer(addrtype address) : Entity(address) {
         player = get_component<Player>();
         life = get_component<Life>();
-        positioned = get_component<Positioned>();;
         actor = get_component<Actor>();;
 
         player_name = player->name();
@@ -256,12 +328,16 @@ public:
         return actor->is_moving();
     }
 
+    Point grid_position() {
+        return positioned ? positioned->grid_position() : Point{0, 0};
+    }
+
     int dist(Entity& entity) {
-        if (!positioned || !entity.has_component("Positioned"))
+        if (!positioned || !entity.positioned)
             return -1;
 
         Point pos1 = positioned->grid_position();
-        Point pos2 = entity.get_component<Positioned>()->grid_position();
+        Point pos2 = entity.positioned->grid_position();
         int dx = pos1.x - pos2.x;
         int dy = pos1.y - pos2.y;
 
@@ -282,6 +358,7 @@ protected:
 
     Base* base;
     Mods* mods;
+    wstring full_name;
     
 public:
 
@@ -298,6 +375,7 @@ public:
         add_method(L"isSynthesised", this, (MethodType)&Item::is_synthesised, AhkBool);
         add_method(L"isVeiled", this, (MethodType)&Item::is_veiled, AhkBool);
         add_method(L"isRGB", this, (MethodType)&Item::is_rgb, AhkBool);
+        add_method(L"socketInfo", this, (MethodType)&Item::get_socket_info, AhkInt64);
         add_method(L"itemLevel", this, (MethodType)&Item::get_item_level);
         add_method(L"quality", this, (MethodType)&Item::get_quality);
         add_method(L"sockets", this, (MethodType)&Item::get_sockets);
@@ -312,6 +390,8 @@ public:
         add_method(L"getMods", this, (MethodType)&Item::get_mods, AhkObject);
         add_method(L"getExplicitStats", this, (MethodType)&Item::get_explicit_stats, AhkObject);
         add_method(L"getStats", this, (MethodType)&Item::get_stats, AhkObject);
+        add_method(L"getNumericStats", this, (MethodType)&Item::get_numeric_stats, AhkObject);
+        add_method(L"getStatValue", this, (MethodType)&Item::get_stat_value, AhkInt, ParamList{AhkWString});
     }
 
     void __new() {
@@ -340,6 +420,22 @@ public:
         return base_name();                                 /* normal or unidentified items */
     }
 
+    /* Same as fullName() of Item.ahk, used to search items by name. */
+    wstring& get_full_name() {
+        if (full_name.empty()) {
+            full_name = name();
+            if (is_identified() && get_rarity() > 1)
+                full_name += L" " + base_name();
+            if (has_component("Map"))
+                full_name += L" (T" + std::to_wstring(get_tier()) + L")";
+            if (has_component("SkillGem"))
+                full_name += L" Level " + std::to_wstring(get_level()) + L" "
+                             + std::to_wstring(get_quality()) + L"%";
+        }
+
+        return full_name;
+    }
+
     wstring& base_name() {
          if (has_component("CapturedMonster"))
             return get_component<CapturedMonster>()->name();
@@ -351,6 +447,11 @@ public:
         return mods ? mods->is_identified() : true;
     }
 
+    /* Returns true if the item was identified or modified in place since it was decoded. */
+    bool is_changed() {
+        return mods && mods->is_changed();
+    }
+
     bool is_blighted() {
         if (mods) {
             mods->get_mods();
@@ -436,6 +537,12 @@ public:
         return sockets ? sockets->is_rgb() : false;
     }
 
+    /* Packed socket word, see SocketBits, 0 for items without sockets. */
+    unsigned __int64 get_socket_info() {
+        Sockets* sockets = get_component<Sockets>();
+        return sockets ? sockets->get_packed() : 0;
+    }
+
     int get_quality() {
         Quality* quality = get_component<Quality>();
         return quality ? quality->quality() : 0;
@@ -470,6 +577,14 @@ public:
         return base ? base->size() : 1;
     }
 
+    int get_width() {
+        return base ? base->width() : 1;
+    }
+
+    int get_height() {
+        return base ? base->height() : 1;
+    }
+
     int get_influence_type() {
         return base ? base->influence_type() : 0;
     }
@@ -522,6 +637,36 @@ public:
 
         return all_stats;
     }
+
+    AhkObjRef* get_numeric_stats() {
+        const wchar_t* source_names[] = {L"implicit", L"enchant", L"explicit"};
+        AhkTempObj numeric_stats;
+
+        if (mods) {
+            for (auto& i : mods->get_numeric_stats()) {
+                AhkObj stat;
+                stat.__set(L"id", stat_table.name(i.stat).c_str(), AhkWString,
+                           L"value", i.value, AhkInt,
+                           L"source", source_names[i.source], AhkWString,
+                           nullptr);
+                numeric_stats.__set(L"", (AhkObjRef*)stat, AhkObject, nullptr);
+            }
+        }
+
+        return numeric_stats;
+    }
+
+    int get_stat_value(const wchar_t* id) {
+        if (mods) {
+            /* the stats of the item must be interned before the lookup. */
+            mods->get_numeric_stats();
+            int stat = stat_table.find(id);
+            if (stat >= 0)
+                return mods->stat_value(stat);
+        }
+
+        return 0;
+    }
 };
 
 AhkObjRef* Entity::get_item() {
@@ -0,0 +1,290 @@
+/*
+* EntityClassifier.cpp, 10/19/2026 9:12 AM
+*/
+
+#include <mutex>
+#include <queue>
+#include <regex>
+#include <unordered_map>
+#include <vector>
+
+/* Aho-Corasick automaton over a set of literals, each literal carries a bitmask
+   and match() returns the union of the bitmasks of all literals found. */
+class LiteralMatcher {
+protected:
+
+    static const int alphabet_size = 128;
+
+    struct State {
+        int next[alphabet_size];
+        int fail;
+        unsigned int bits;
+    };
+
+    std::vector<State> states;
+    bool is_compiled = false;
+
+    int new_state() {
+        states.push_back({});
+        std::fill(states.back().next, states.back().next + alphabet_size, -1);
+        return states.size() - 1;
+    }
+
+public:
+
+    LiteralMatcher() {
+        new_state();
+    }
+
+    void add(const wstring& literal, unsigned int bits) {
+        int s = 0;
+
+        for (wchar_t c : literal) {
+            if (c >= alphabet_size)     /* paths are ASCII, ignore others */
+                return;
+
+            if (states[s].next[c] < 0) {
+                int t = new_state();
+                states[s].next[c] = t;
+            }
+            s = states[s].next[c];
+        }
+        states[s].bits |= bits;
+        is_compiled = false;
+    }
+
+    void compile() {
+        std::queue<int> queue;
+
+        /* build failure links breadth-first and turn the trie into a DFA. */
+        states[0].fail = 0;
+        for (int c = 0; c < alphabet_size; ++c) {
+            int s = states[0].next[c];
+            if (s < 0) {
+                states[0].next[c] = 0;
+            } else {
+                states[s].fail = 0;
+                queue.push(s);
+            }
+        }
+
+        while (!queue.empty()) {
+            int s = queue.front();
+            queue.pop();
+
+            states[s].bits |= states[states[s].fail].bits;
+            for (int c = 0; c < alphabet_size; ++c) {
+                int t = states[s].next[c];
+                if (t < 0) {
+                    states[s].next[c] = states[states[s].fail].next[c];
+                } else {
+                    states[t].fail = states[states[s].fail].next[c];
+                    queue.push(t);
+                }
+            }
+        }
+
+        is_compiled = true;
+    }
+
+    unsigned int match(const wstring& str) {
+        unsigned int bits = 0;
+        int s = 0;
+
+        if (!is_compiled)
+            compile();
+
+        for (wchar_t c : str) {
+            s = (c < alphabet_size) ? states[s].next[c] : 0;
+            bits |= states[s].bits;
+        }
+
+        return bits;
+    }
+};
+
+enum EntityCategories {
+    CATEGORY_IGNORED             = 0x1,
+    CATEGORY_DELVE_CHEST         = 0x2,
+    CATEGORY_HEIST_CHEST         = 0x4,
+    CATEGORY_IZARO_CHEST         = 0x8,
+    CATEGORY_AFFLICTION_VOLATILE = 0x10,
+    CATEGORY_LABYRINTH_OBJECT    = 0x20,
+    CATEGORY_DELVE_CHEST_NAME    = 0x40,    /* looser than the paths above, for AutoOpen */
+    CATEGORY_HEIST_CHEST_NAME    = 0x80,
+
+    /* delve chest rewards */
+    CATEGORY_AZURITE_VEIN        = 0x100,
+    CATEGORY_RESONATOR           = 0x200,
+    CATEGORY_FOSSIL              = 0x400,
+    CATEGORY_CURRENCY            = 0x800,
+    CATEGORY_MAP                 = 0x1000,
+    CATEGORY_SUPPLIES_DYNAMITE   = 0x2000,
+    CATEGORY_SUPPLIES_FLARES     = 0x4000,
+    CATEGORY_UNIQUE              = 0x8000,
+};
+
+static std::vector<std::pair<const wchar_t*, unsigned int>> entity_category_literals = {
+    {L"Doodad",             CATEGORY_IGNORED},
+    {L"WorldItem",          CATEGORY_IGNORED},
+    {L"Barrel",             CATEGORY_IGNORED},
+    {L"Basket",             CATEGORY_IGNORED},
+    {L"Bloom",              CATEGORY_IGNORED},
+    {L"BonePile",           CATEGORY_IGNORED},
+    {L"Boulder",            CATEGORY_IGNORED},
+    {L"Cairn",              CATEGORY_IGNORED},
+    {L"Crate",              CATEGORY_IGNORED},
+    {L"Pot",                CATEGORY_IGNORED},
+    {L"Urn",                CATEGORY_IGNORED},
+    {L"Vase",               CATEGORY_IGNORED},
+    {L"BlightFoundation",   CATEGORY_IGNORED},
+    {L"BlightTower",        CATEGORY_IGNORED},
+    {L"Effects",            CATEGORY_IGNORED},
+    {L"/DelveChests",       CATEGORY_DELVE_CHEST},
+    {L"/HeistChest",        CATEGORY_HEIST_CHEST},
+    {L"DelveChest",         CATEGORY_DELVE_CHEST_NAME},
+    {L"HeistChest",         CATEGORY_HEIST_CHEST_NAME},
+    {L"IzaroChest",         CATEGORY_IZARO_CHEST},
+    {L"AfflictionVolatile", CATEGORY_AFFLICTION_VOLATILE},
+    {L"Labyrinth/Objects",  CATEGORY_LABYRINTH_OBJECT},
+    {L"AzuriteVein",        CATEGORY_AZURITE_VEIN},
+    {L"Resonator",          CATEGORY_RESONATOR},
+    {L"Fossil",             CATEGORY_FOSSIL},
+    {L"Currency",           CATEGORY_CURRENCY},
+    {L"Map",                CATEGORY_MAP},
+    {L"SuppliesDynamite",   CATEGORY_SUPPLIES_DYNAMITE},
+    {L"SuppliesFlares",     CATEGORY_SUPPLIES_FLARES},
+    {L"Unique",             CATEGORY_UNIQUE},
+};
+
+/* Classifies entity paths into category bits, the result is cached by the address
+   of the entity's internal (type) object which holds the interned path string. */
+class EntityClassifier {
+protected:
+
+    LiteralMatcher matcher;
+    std::unordered_map<addrtype, unsigned int> categories;
+    std::mutex mutex;
+
+public:
+
+    EntityClassifier() {
+        for (auto& i : entity_category_literals)
+            matcher.add(i.first, i.second);
+        matcher.compile();
+    }
+
+    bool lookup(addrtype internal, unsigned int& category) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = categories.find(internal);
+        if (i != categories.end()) {
+            category = i->second;
+            return true;
+        }
+
+        return false;
+    }
+
+    unsigned int classify(addrtype internal, const wstring& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = categories.find(internal);
+        if (i != categories.end())
+            return i->second;
+
+        unsigned int category = matcher.match(path);
+        categories[internal] = category;
+
+        return category;
+    }
+
+    /* Restore a category classified before, e.g. from the area cache. */
+    void insert(addrtype internal, unsigned int category) {
+        std::lock_guard<std::mutex> lock(mutex);
+        categories[internal] = category;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        categories.clear();
+    }
+};
+
+/* Global entity classifier */
+EntityClassifier entity_classifier;
+
+/* Debug routine, classifies a corpus of entity paths with the matcher and with
+   path.find() of every literal and with a std::wregex alternation of the literals,
+   then times the matcher against the regex. Returns the number of paths classified
+   differently by any of them, the times are in microseconds per path. */
+int check_classifier(float& matcher_time, float& regex_time, int rounds = 100) {
+    std::vector<wstring> paths = {
+        L"Metadata/Monsters/Zombies/ZombieMaleStandard",
+        L"Metadata/Monsters/Skeletons/SkeletonBowLightning",
+        L"Metadata/Monsters/LeagueAffliction/Volatile/AfflictionVolatile",
+        L"Metadata/MiscellaneousObjects/Stash",
+        L"Metadata/MiscellaneousObjects/AreaTransition",
+        L"Metadata/MiscellaneousObjects/Waypoint",
+        L"Metadata/Terrain/Doodads/Sewers/SewerGrate",
+        L"Metadata/Effects/Spells/monsters_effects/Fire/FireballImpact",
+        L"Metadata/NPC/Hideout/StrDexInt",
+        L"Metadata/Terrain/Labyrinth/Objects/LabyrinthTrapSpikes",
+        L"Metadata/Chests/Labyrinth/IzaroChestLarge",
+        L"Metadata/Chests/LeagueHeist/HeistChestSecondaryCurrencyMilitary",
+        L"Metadata/Chests/DelveChests/DelveChestCurrencyHighShipment",
+        L"Metadata/Chests/DelveChests/DelveChestResonatorNormal",
+        L"Metadata/Chests/DelveChests/DelveAzuriteVein1_1",
+        L"Metadata/Chests/DelveChests/DelveChestSuppliesDynamite",
+        L"Metadata/Chests/DelveChests/DelveChestMapHigh",
+        L"Metadata/Chests/DelveChests/DelveChestUniqueArmour",
+    };
+    wstring alternation;
+    LiteralMatcher matcher;
+    LARGE_INTEGER frequency, begin, end;
+    int mismatches = 0;
+
+    for (auto& i : entity_category_literals) {
+        paths.push_back(wstring(L"Metadata/Chests/") + i.first + L"Large1");
+        alternation += (alternation.empty() ? L"" : L"|") + wstring(i.first);
+        matcher.add(i.first, i.second);
+    }
+    matcher.compile();
+
+    std::wregex regex(alternation);
+    for (auto& path : paths) {
+        unsigned int bits = 0;
+        for (auto& i : entity_category_literals) {
+            if (path.find(i.first) != wstring::npos)
+                bits |= i.second;
+        }
+        unsigned int category = matcher.match(path);
+        if (category != bits || (category != 0) != std::regex_search(path, regex))
+            mismatches++;
+    }
+
+    int n = rounds * paths.size(), matched = 0;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    for (int r = 0; r < rounds; ++r) {
+        for (auto& path : paths)
+            matched += (matcher.match(path) != 0);
+    }
+    QueryPerformanceCounter(&end);
+    matcher_time = (end.QuadPart - begin.QuadPart) * 1e6 / frequency.QuadPart / n;
+
+    QueryPerformanceCounter(&begin);
+    for (int r = 0; r < rounds; ++r) {
+        for (auto& path : paths)
+            matched += std::regex_search(path, regex);
+    }
+    QueryPerformanceCounter(&end);
+    regex_time = (end.QuadPart - begin.QuadPart) * 1e6 / frequency.QuadPart / n;
+
+    /* keeps the timed loops from being optimized out */
+    if (matched < 0)
+        mismatches++;
+
+    return mismatches;
+}
@@ -0,0 +1,137 @@
+/*
+* EntityDecoder.cpp, 10/19/2026 5:30 PM
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Decodes new entities on a small pool of worker threads, used when an area was
+   loaded or many entities spawned at once. The workers are started on the first
+   burst and the calling thread joins the decoding. */
+class EntityDecoder {
+protected:
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready, work_done;
+    std::vector<addrtype>* addresses = nullptr;
+    std::vector<shared_ptr<Entity>>* results = nullptr;
+    std::atomic<int> next;
+    int count = 0;
+    int remaining = 0;
+    int active = 0;
+    unsigned int batch = 0;
+    bool stopped = false;
+
+    /* count is taken under the lock, so late workers never look at the vectors. */
+    void decode_items(int size) {
+        int i, n = 0;
+
+        while ((i = next++) < size) {
+            (*results)[i] = shared_ptr<Entity>(new Entity((*addresses)[i]));
+            n++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        remaining -= n;
+        if (remaining == 0)
+            work_done.notify_all();
+    }
+
+    void worker() {
+        unsigned int seen;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen = batch;
+        }
+
+        while (1) {
+            int n;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [&] {return stopped || batch != seen;});
+                if (stopped)
+                    return;
+                seen = batch;
+                n = count;
+                active++;
+            }
+
+            decode_items(n);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+                work_done.notify_all();
+        }
+    }
+
+public:
+
+    int threshold = 32;         /* smaller bursts are decoded by the calling thread */
+    int max_workers = 4;
+    int parallel_count = 0;     /* entities decoded by the pool */
+
+    EntityDecoder() : next(0) {
+    }
+
+    ~EntityDecoder() {
+        stop();
+    }
+
+    void start() {
+        int n = std::thread::hardware_concurrency();
+        n = std::max(1, std::min(n - 1, max_workers));
+
+        stopped = false;
+        for (int i = 0; i < n; ++i)
+            workers.push_back(std::thread(&EntityDecoder::worker, this));
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        work_ready.notify_all();
+
+        for (auto& t : workers)
+            t.join();
+        workers.clear();
+    }
+
+    /* Decodes the entities at the given addresses, results[i] is the entity at addresses[i]. */
+    void decode(std::vector<addrtype>& addresses, std::vector<shared_ptr<Entity>>& results) {
+        results.clear();
+        results.resize(addresses.size());
+        if (addresses.size() < threshold) {
+            for (int i = 0; i < addresses.size(); ++i)
+                results[i] = shared_ptr<Entity>(new Entity(addresses[i]));
+            return;
+        }
+
+        if (workers.empty())
+            start();
+
+        {
+            /* workers late for the previous batch must be gone before it is replaced. */
+            std::unique_lock<std::mutex> lock(mutex);
+            work_done.wait(lock, [&] {return active == 0;});
+            this->addresses = &addresses;
+            this->results = &results;
+            next = 0;
+            count = remaining = addresses.size();
+            batch++;
+        }
+        work_ready.notify_all();
+
+        decode_items(addresses.size());
+
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [&] {return remaining == 0 && active == 0;});
+        parallel_count += addresses.size();
+    }
+};
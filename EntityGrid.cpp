@@ -0,0 +1,216 @@
+/*
+* EntityGrid.cpp, 10/19/2026 11:40 AM
+*/
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/* Uniform grid over the entities' grid positions, used for radius and nearest
+   queries around the player without scanning the whole entity list. */
+class EntityGrid {
+protected:
+
+    std::unordered_map<__int64, std::vector<Entity*>> cells;
+    std::vector<Entity*> result;
+    std::vector<std::pair<__int64, Entity*>> heap;
+    int cell_size;
+    int min_x, min_y, max_x, max_y;
+
+    __int64 key(int cx, int cy) {
+        return ((__int64)cx << 32) | (unsigned int)cy;
+    }
+
+    int cell_of(int v) {
+        return (v >= 0) ? v / cell_size : (v - cell_size + 1) / cell_size;
+    }
+
+    __int64 distance2(Point& p1, Point& p2) {
+        __int64 dx = p1.x - p2.x;
+        __int64 dy = p1.y - p2.y;
+
+        return dx * dx + dy * dy;
+    }
+
+    /* calls func for every entity in the cells at chebyshev distance r from (cx, cy). */
+    template <typename F> void for_each_in_ring(int cx, int cy, int r, F func) {
+        for (int y = cy - r; y <= cy + r; ++y) {
+            int step = (y == cy - r || y == cy + r) ? 1 : 2 * r;
+            for (int x = cx - r; x <= cx + r; x += step) {
+                auto i = cells.find(key(x, y));
+                if (i != cells.end()) {
+                    for (Entity* e : i->second)
+                        func(e);
+                }
+            }
+        }
+    }
+
+    int max_ring(int cx, int cy) {
+        if (min_x > max_x)
+            return -1;
+
+        return std::max(std::max(cx - min_x, max_x - cx), std::max(cy - min_y, max_y - cy));
+    }
+
+public:
+
+    int size = 0;
+
+    EntityGrid(int cell_size = 32) : cell_size(cell_size) {
+        clear();
+    }
+
+    static int distance(Point p1, Point p2) {
+        int dx = p1.x - p2.x;
+        int dy = p1.y - p2.y;
+
+        return sqrt(dx * dx + dy * dy);
+    }
+
+    void clear() {
+        cells.clear();
+        size = 0;
+        min_x = min_y = INT_MAX;
+        max_x = max_y = INT_MIN;
+    }
+
+    void insert(Entity* e) {
+        int cx = cell_of(e->pos.x), cy = cell_of(e->pos.y);
+
+        cells[key(cx, cy)].push_back(e);
+        min_x = std::min(min_x, cx);
+        min_y = std::min(min_y, cy);
+        max_x = std::max(max_x, cx);
+        max_y = std::max(max_y, cy);
+        size++;
+    }
+
+    void remove(Entity* e) {
+        auto i = cells.find(key(cell_of(e->pos.x), cell_of(e->pos.y)));
+        if (i != cells.end()) {
+            std::vector<Entity*>& v = i->second;
+            auto j = std::find(v.begin(), v.end(), e);
+            if (j != v.end()) {
+                *j = v.back();
+                v.pop_back();
+                size--;
+                if (v.empty())
+                    cells.erase(i);
+            }
+        }
+    }
+
+    void move(Entity* e, Point pos) {
+        if (cell_of(pos.x) != cell_of(e->pos.x) || cell_of(pos.y) != cell_of(e->pos.y)) {
+            remove(e);
+            e->pos = pos;
+            insert(e);
+        } else {
+            e->pos = pos;
+        }
+    }
+
+    /* Apply one tick of changes, the positions come from the entity table. Only
+       the entities with a moved event of the table are moved, so the position in
+       the grid may lag the table's by up to its move_epsilon. */
+    void update(EntityTable& table, EntityList& removed, EntityList& added) {
+        for (auto& i : removed) {
+            if (i.second->positioned)
+                remove(i.second.get());
+        }
+
+        for (auto& i : added) {
+            Entity* e = i.second.get();
+            if (e->positioned && e->slot >= 0) {
+                e->pos = table.grid_positions[e->slot];
+                insert(e);
+            }
+        }
+
+        for (auto& i : table.events) {
+            Entity* e = i.entity;
+            if (i.type == ENTITY_MOVED && e->positioned && e->slot >= 0)
+                move(e, table.grid_positions[e->slot]);
+        }
+    }
+
+    /* Entities within radius, with the same truncated distance as distance(). */
+    std::vector<Entity*>& query_radius(Point center, int radius) {
+        int cx0 = cell_of(center.x - radius), cx1 = cell_of(center.x + radius);
+        int cy0 = cell_of(center.y - radius), cy1 = cell_of(center.y + radius);
+        __int64 r2 = (__int64)(radius + 1) * (radius + 1);
+
+        result.clear();
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                auto i = cells.find(key(cx, cy));
+                if (i == cells.end())
+                    continue;
+
+                for (Entity* e : i->second) {
+                    if (distance2(center, e->pos) < r2)
+                        result.push_back(e);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /* Returns up to k entities nearest to center and accepted by pred, ordered by distance.
+       radius < 0 means unlimited. */
+    std::vector<Entity*>& k_nearest(Point center, int k, int radius = -1,
+                                    std::function<bool (Entity*)> pred = nullptr)
+    {
+        int cx = cell_of(center.x), cy = cell_of(center.y);
+        int rings = max_ring(cx, cy);
+        __int64 r2 = (radius < 0) ? LLONG_MAX : (__int64)(radius + 1) * (radius + 1);
+        auto compare = [](const std::pair<__int64, Entity*>& a, const std::pair<__int64, Entity*>& b) {
+            return a.first < b.first;
+        };
+
+        heap.clear();
+        result.clear();
+        if (k <= 0)
+            return result;
+
+        if (radius >= 0)
+            rings = std::min(rings, radius / cell_size + 1);
+
+        for (int r = 0; r <= rings; ++r) {
+            /* entities in ring r and beyond are at least (r - 1) * cell_size away. */
+            __int64 bound = (__int64)r * cell_size;
+            if (r > 0 && heap.size() == k && heap.front().first <= (bound - cell_size) * (bound - cell_size))
+                break;
+
+            for_each_in_ring(cx, cy, r, [&](Entity* e) {
+                __int64 d2 = distance2(center, e->pos);
+                if (d2 >= r2 || (heap.size() == k && d2 >= heap.front().first))
+                    return;
+                if (pred && !pred(e))
+                    return;
+
+                heap.push_back(std::make_pair(d2, e));
+                std::push_heap(heap.begin(), heap.end(), compare);
+                if (heap.size() > k) {
+                    std::pop_heap(heap.begin(), heap.end(), compare);
+                    heap.pop_back();
+                }
+            });
+        }
+
+        std::sort_heap(heap.begin(), heap.end(), compare);
+        for (auto& i : heap)
+            result.push_back(i.second);
+
+        return result;
+    }
+
+    Entity* nearest(Point center, int radius = -1, std::function<bool (Entity*)> pred = nullptr) {
+        std::vector<Entity*>& v = k_nearest(center, 1, radius, pred);
+        return v.empty() ? nullptr : v.front();
+    }
+};
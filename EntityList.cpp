@@ -0,0 +1,205 @@
+/*
+* EntityList.cpp, 10/19/2026 4:20 PM
+*/
+
+#include <utility>
+#include <vector>
+
+/* Flat hash table of entities keyed by id, open addressing with linear probing and
+   backward shift deletion. The storage is kept when entries are removed or cleared,
+   so a steady entity list does not allocate. */
+class EntityList {
+public:
+
+    using value_type = std::pair<int, shared_ptr<Entity>>;
+
+    class iterator {
+    protected:
+
+        EntityList* list;
+        int index;
+
+        /* empty slots have no entity */
+        void skip() {
+            while (index < list->slots.size() && !list->slots[index].second)
+                ++index;
+        }
+
+    public:
+
+        iterator(EntityList* list, int index) : list(list), index(index) {
+            skip();
+        }
+
+        value_type& operator*() {
+            return list->slots[index];
+        }
+
+        value_type* operator->() {
+            return &list->slots[index];
+        }
+
+        iterator& operator++() {
+            ++index;
+            skip();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return index == other.index;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return index != other.index;
+        }
+
+        friend class EntityList;
+    };
+
+protected:
+
+    std::vector<value_type> slots;
+    int count = 0;
+    int mask = 0;
+    int shift = 32;
+
+    int home_of(int id) {
+        return ((unsigned int)id * 2654435769u) >> shift;
+    }
+
+    int index_of(int id) {
+        if (slots.empty())
+            return -1;
+
+        for (int i = home_of(id); slots[i].second; i = (i + 1) & mask) {
+            if (slots[i].first == id)
+                return i;
+        }
+
+        return -1;
+    }
+
+    void rehash(int capacity) {
+        std::vector<value_type> old_slots(capacity);
+
+        old_slots.swap(slots);
+        mask = capacity - 1;
+        for (shift = 32; capacity > 1; capacity >>= 1)
+            shift--;
+
+        count = 0;
+        for (auto& i : old_slots) {
+            if (i.second)
+                insert(std::move(i));
+        }
+    }
+
+    void erase_at(int i) {
+        slots[i].second.reset();
+        count--;
+
+        /* move the following entries of the cluster back unless they are already
+           between their home slot and the hole. */
+        for (int j = (i + 1) & mask; slots[j].second; j = (j + 1) & mask) {
+            int home = home_of(slots[j].first);
+            bool in_place = (i < j) ? (home > i && home <= j) : (home > i || home <= j);
+            if (!in_place) {
+                slots[i] = std::move(slots[j]);
+                i = j;
+            }
+        }
+    }
+
+public:
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, slots.size());
+    }
+
+    int size() {
+        return count;
+    }
+
+    bool empty() {
+        return count == 0;
+    }
+
+    iterator find(int id) {
+        int i = index_of(id);
+        return (i < 0) ? end() : iterator(this, i);
+    }
+
+    /* Returns the entity with the given id, or null without inserting anything. */
+    shared_ptr<Entity> operator[](int id) {
+        int i = index_of(id);
+        return (i < 0) ? nullptr : slots[i].second;
+    }
+
+    iterator insert(value_type value) {
+        if (!value.second)
+            return end();
+
+        if ((count + 1) * 2 > (int)slots.size())
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+
+        int i = home_of(value.first);
+        for (; slots[i].second; i = (i + 1) & mask) {
+            if (slots[i].first == value.first)
+                return iterator(this, i);
+        }
+
+        slots[i] = std::move(value);
+        count++;
+
+        return iterator(this, i);
+    }
+
+    /* Removes the entry, the returned iterator must be checked again because
+       an entry of the same cluster may have been moved into its place. */
+    iterator erase(iterator i) {
+        erase_at(i.index);
+        return iterator(this, i.index);
+    }
+
+    bool erase(int id) {
+        int i = index_of(id);
+        if (i < 0)
+            return false;
+
+        erase_at(i);
+        return true;
+    }
+
+    /* Removes all entries accepted by pred in one sweep. */
+    template <typename F> int erase_if(F pred) {
+        int n = 0;
+
+        for (int i = 0; i < slots.size();) {
+            if (slots[i].second && pred(slots[i])) {
+                erase_at(i);
+                n++;
+            } else {
+                ++i;
+            }
+        }
+
+        return n;
+    }
+
+    void clear() {
+        for (auto& i : slots)
+            i.second.reset();
+        count = 0;
+    }
+
+    void swap(EntityList& other) {
+        slots.swap(other.slots);
+        std::swap(count, other.count);
+        std::swap(mask, other.mask);
+        std::swap(shift, other.shift);
+    }
+};
@@ -0,0 +1,118 @@
+/*
+* EntityQuery.cpp, 10/19/2026 9:30 PM
+*/
+
+#include <regex>
+#include <unordered_map>
+#include <vector>
+
+enum EntityQueryState {
+    QUERY_ANY,
+    QUERY_ALIVE,
+    QUERY_DEAD,
+};
+
+/* Entity filter compiled once and evaluated against the published snapshots. The
+   type dependent part (path and components) is cached per archetype, the results
+   are cached per snapshot. */
+class EntityQuery {
+protected:
+
+    std::wregex path_regex;
+    bool has_path_pattern;
+    std::unordered_map<shared_ptr<Archetype>, bool> matches;
+    shared_ptr<const EntitySnapshot> last_snapshot;
+    int max_cached_types = 4096;
+
+    bool match_type(Entity* e) {
+        auto i = matches.find(e->archetype);
+        if (i != matches.end())
+            return i->second;
+
+        bool matched = !has_path_pattern || std::regex_search(e->path, path_regex);
+        for (auto& name : required)
+            matched = matched && e->has_component(name);
+        for (auto& name : excluded)
+            matched = matched && !e->has_component(name);
+
+        /* the archetypes are replaced on area change. */
+        if (matches.size() >= max_cached_types)
+            matches.clear();
+        matches[e->archetype] = matched;
+
+        return matched;
+    }
+
+    bool match_state(Entity* e, const EntityState& state, Point& player_pos) {
+        if (e->rarity < min_rarity)
+            return false;
+
+        if ((this->state == QUERY_ALIVE && state.life == 0)
+            || (this->state == QUERY_DEAD && state.life != 0))
+            return false;
+
+        if (max_distance >= 0 && EntityGrid::distance(player_pos, state.pos) > max_distance)
+            return false;
+
+        return true;
+    }
+
+public:
+
+    wstring pattern;
+    std::vector<string> required, excluded;
+    int min_rarity;
+    int state;
+    int max_distance;
+    std::vector<shared_ptr<Entity>> results;
+    int evaluated = 0;                      /* number of times the query was really run */
+
+    /* components is a comma separated list of component names, names prefixed by
+       '-' must not be present. max_distance < 0 means unlimited. */
+    EntityQuery(const wstring& pattern, const string& components = "", int min_rarity = 0,
+                int state = QUERY_ANY, int max_distance = -1)
+        : pattern(pattern), has_path_pattern(!pattern.empty()), min_rarity(min_rarity),
+          state(state), max_distance(max_distance)
+    {
+        if (has_path_pattern)
+            path_regex.assign(pattern, std::regex::optimize);
+
+        for (int begin = 0, end; begin < components.size(); begin = end + 1) {
+            end = components.find(',', begin);
+            if (end == string::npos)
+                end = components.size();
+
+            string name = components.substr(begin, end - begin);
+            name.erase(0, name.find_first_not_of(' '));
+            name.erase(name.find_last_not_of(' ') + 1);
+            if (name.empty())
+                continue;
+
+            if (name[0] == '-')
+                excluded.push_back(name.substr(1));
+            else
+                required.push_back(name);
+        }
+    }
+
+    /* Returns the matched entities, run again only when a new snapshot was published. */
+    std::vector<shared_ptr<Entity>>& run(shared_ptr<const EntitySnapshot>& snapshot) {
+        if (snapshot == last_snapshot)
+            return results;
+
+        results.clear();
+        last_snapshot = snapshot;
+        if (!snapshot)
+            return results;
+
+        Point player_pos = snapshot->player_pos;
+        for (int i = 0; i < snapshot->entities.size(); ++i) {
+            Entity* e = snapshot->entities[i].get();
+            if (match_type(e) && match_state(e, snapshot->states[i], player_pos))
+                results.push_back(snapshot->entities[i]);
+        }
+        evaluated++;
+
+        return results;
+    }
+};
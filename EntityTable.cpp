@@ -0,0 +1,215 @@
+/*
+* EntityTable.cpp, 10/19/2026 2:05 PM
+*/
+
+enum EntityEventType {
+    ENTITY_SPAWNED,
+    ENTITY_DESPAWNED,
+    ENTITY_DIED,
+    ENTITY_MOVED,
+    ENTITY_TARGETABLE,
+    ENTITY_CHEST_OPENED,
+    ENTITY_LIFE_GAINED,     /* the life rose above 1 from 1 or an unread life */
+};
+
+/* The entity of a despawned event stays valid until the next tick. */
+struct EntityEvent {
+    int type;
+    int id;
+    Entity* entity;
+};
+
+using EntityEvents = std::vector<EntityEvent>;
+
+/* Volatile entity state, stored column by column and indexed by the entity's slot.
+   All columns are refreshed by one batched read at the start of the tick, so the
+   plugins share the values instead of reading them again. */
+class EntityTable : public PoEMemory {
+protected:
+
+    /* addresses of the components the columns are read from */
+    struct Sources {
+        addrtype positioned, render, life, targetable, chest, actor;
+    };
+
+    std::vector<Sources> sources;
+    ReadBatch batch;
+
+    /* values of the previous tick, used to find the transitions */
+    std::vector<int> last_life;
+    std::vector<byte> last_targetable;
+    std::vector<byte> last_chest_opened;
+    std::vector<Point> moved_from;
+    std::vector<byte> life_read;        /* 1 if the life of this tick was read */
+
+    addrtype component_address(Component* component) {
+        return component ? component->address : 0;
+    }
+
+    void add(Entity* e) {
+        e->slot = entities.size();
+        entities.push_back(e);
+        sources.push_back({component_address(e->positioned),
+                           component_address(e->get_component<Render>()),
+                           component_address(e->get_component<Life>()),
+                           component_address(e->get_component<Targetable>()),
+                           component_address(e->get_component<Chest>()),
+                           component_address(e->get_component<Actor>())});
+        grid_positions.push_back({0, 0});
+        moved_from.push_back({0, 0});
+        positions.push_back({0, 0, 0});
+        life.push_back(-1);
+        targetable.push_back(0);
+        chest_opened.push_back(0);
+        actions.push_back(0);
+    }
+
+    /* keep the columns dense, the last slot is moved into the hole. */
+    void remove(Entity* e) {
+        int slot = e->slot, last = entities.size() - 1;
+        if (slot < 0 || slot > last || entities[slot] != e)
+            return;
+
+        if (slot != last) {
+            entities[slot] = entities[last];
+            entities[slot]->slot = slot;
+            sources[slot] = sources[last];
+            grid_positions[slot] = grid_positions[last];
+            moved_from[slot] = moved_from[last];
+            positions[slot] = positions[last];
+            life[slot] = life[last];
+            targetable[slot] = targetable[last];
+            chest_opened[slot] = chest_opened[last];
+            actions[slot] = actions[last];
+        }
+
+        entities.pop_back();
+        sources.pop_back();
+        grid_positions.pop_back();
+        moved_from.pop_back();
+        positions.pop_back();
+        life.pop_back();
+        targetable.pop_back();
+        chest_opened.pop_back();
+        actions.pop_back();
+        e->slot = -1;
+    }
+
+public:
+
+    std::vector<Entity*> entities;
+    std::vector<Point> grid_positions;
+    std::vector<Vector3> positions;         /* Render position */
+    std::vector<int> life;                  /* -1 if the entity has no Life component or it was never read */
+    std::vector<byte> targetable;
+    std::vector<byte> chest_opened;
+    std::vector<short> actions;             /* ActionFlags */
+    int reads = 0;                          /* remote reads issued by the last update */
+    int move_epsilon = 2;                   /* in grid units */
+    EntityEvents events;
+
+    int size() {
+        return entities.size();
+    }
+
+    void clear() {
+        for (Entity* e : entities)
+            e->slot = -1;
+        entities.clear();
+        sources.clear();
+        grid_positions.clear();
+        moved_from.clear();
+        positions.clear();
+        life.clear();
+        targetable.clear();
+        chest_opened.clear();
+        actions.clear();
+        events.clear();
+    }
+
+    void update(EntityList& removed, EntityList& added) {
+        events.clear();
+        for (auto& i : removed) {
+            events.push_back({ENTITY_DESPAWNED, i.first, i.second.get()});
+            remove(i.second.get());
+        }
+
+        int n = entities.size();
+        last_life.assign(life.begin(), life.end());
+        last_targetable.assign(targetable.begin(), targetable.end());
+        last_chest_opened.assign(chest_opened.begin(), chest_opened.end());
+
+        for (auto& i : added) {
+            events.push_back({ENTITY_SPAWNED, i.first, i.second.get()});
+            add(i.second.get());
+        }
+
+        /* the offsets may be changed by setOffset(), look them up once per tick. */
+        int grid_position_offset = positioned_component_offsets["grid_position"];
+        int position_offset = render_component_offsets["position"];
+        int life_offset = life_component_offsets["life"];
+        int targetable_offset = targetable_component_offsets["is_targetable"];
+        int opened_offset = chest_component_offsets["is_opened"];
+        int action_offset = actor_component_offsets["action_id"];
+
+        life_read.assign(entities.size(), 0);
+        for (int i = 0; i < entities.size(); ++i) {
+            Sources& s = sources[i];
+
+            /* positions of the static entities are only read once. */
+            if (i >= n || entities[i]->is_movable) {
+                if (s.positioned)
+                    batch.add(s.positioned + grid_position_offset, &grid_positions[i]);
+                if (s.render)
+                    batch.add(s.render + position_offset, &positions[i]);
+            }
+
+            if (s.life)
+                batch.add(s.life + life_offset, &life[i], &life_read[i]);
+            if (s.targetable)
+                batch.add(s.targetable + targetable_offset, &targetable[i]);
+            if (s.chest)
+                batch.add(s.chest + opened_offset, &chest_opened[i]);
+            if (s.actor)
+                batch.add(s.actor + action_offset, &actions[i]);
+        }
+
+        reads = PoEMemory::read(batch);
+
+        /* a failed read zeroes the life, which is not a death. The last value is
+           kept, or -1 for a new entity, as if it had no Life component yet. */
+        for (int i = 0; i < entities.size(); ++i) {
+            if (sources[i].life && !life_read[i])
+                life[i] = (i < n) ? last_life[i] : -1;
+        }
+
+        for (int i = n; i < entities.size(); ++i)
+            moved_from[i] = grid_positions[i];
+
+        /* transitions of the entities which were already in the table. */
+        for (int i = 0; i < n; ++i) {
+            Entity* e = entities[i];
+
+            if (last_life[i] > 0 && life[i] == 0)
+                events.push_back({ENTITY_DIED, e->id, e});
+
+            if ((last_life[i] == 1 || last_life[i] == -1) && life[i] > 1)
+                events.push_back({ENTITY_LIFE_GAINED, e->id, e});
+
+            if (!last_targetable[i] && targetable[i])
+                events.push_back({ENTITY_TARGETABLE, e->id, e});
+
+            if (!last_chest_opened[i] && chest_opened[i])
+                events.push_back({ENTITY_CHEST_OPENED, e->id, e});
+
+            if (e->is_movable) {
+                int dx = grid_positions[i].x - moved_from[i].x;
+                int dy = grid_positions[i].y - moved_from[i].y;
+                if (dx * dx + dy * dy > move_epsilon * move_epsilon) {
+                    moved_from[i] = grid_positions[i];
+                    events.push_back({ENTITY_MOVED, e->id, e});
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,117 @@
+/*
+* FlatSet.cpp, 10/19/2026 11:50 PM
+*/
+
+#include <vector>
+
+/* Flat open addressing set of integer keys (addresses or ids) with linear probing.
+   The table is sized from the expected count, so a tick of inserts does not rehash,
+   and clear() keeps the storage. */
+template <typename K> class FlatSet {
+protected:
+
+    std::vector<K> keys;
+    std::vector<bool> used;
+    int entries = 0;
+    int mask = 0;
+
+    int home_of(K key) {
+        unsigned __int64 h = (unsigned __int64)key * 0x9e3779b97f4a7c15ull;
+        return (h >> 32) & mask;
+    }
+
+    void rehash(int capacity) {
+        std::vector<K> old_keys(capacity);
+        std::vector<bool> old_used(capacity);
+
+        old_keys.swap(keys);
+        old_used.swap(used);
+        mask = capacity - 1;
+        entries = 0;
+        for (int i = 0; i < old_keys.size(); ++i) {
+            if (old_used[i])
+                insert(old_keys[i]);
+        }
+    }
+
+public:
+
+    int size() {
+        return entries;
+    }
+
+    bool empty() {
+        return entries == 0;
+    }
+
+    /* Make room for n keys without rehashing. */
+    void reserve(int n) {
+        int capacity = 64;
+        while (capacity < n * 2)
+            capacity <<= 1;
+        if (capacity > keys.size())
+            rehash(capacity);
+    }
+
+    int count(K key) {
+        if (keys.empty())
+            return 0;
+
+        for (int i = home_of(key); used[i]; i = (i + 1) & mask) {
+            if (keys[i] == key)
+                return 1;
+        }
+
+        return 0;
+    }
+
+    /* Returns false if the key was already in the set. */
+    bool insert(K key) {
+        if ((entries + 1) * 2 > (int)keys.size())
+            rehash(keys.empty() ? 64 : keys.size() * 2);
+
+        int i = home_of(key);
+        for (; used[i]; i = (i + 1) & mask) {
+            if (keys[i] == key)
+                return false;
+        }
+
+        keys[i] = key;
+        used[i] = true;
+        entries++;
+
+        return true;
+    }
+
+    template <typename F> void for_each(F func) {
+        for (int i = 0; i < keys.size(); ++i) {
+            if (used[i])
+                func(keys[i]);
+        }
+    }
+
+    void clear() {
+        if (entries > 0)
+            std::fill(used.begin(), used.end(), false);
+        entries = 0;
+    }
+};
+
+/* Debug routine, returns the microseconds taken to fill a set sized for n synthetic
+   node addresses and to look each of them up twice, as one entity scan does. */
+float benchmark_flat_set(int n) {
+    FlatSet<addrtype> set;
+    LARGE_INTEGER frequency, begin, end;
+    int found = 0;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&begin);
+    set.reserve(n + n / 4 + 64);
+    for (int i = 0; i < n; ++i)
+        set.insert(0x20000000000ull + i * 0x60ull);
+    for (int i = 0; i < 2 * n; ++i)
+        found += set.count(0x20000000000ull + (i % n) * 0x60ull);
+    QueryPerformanceCounter(&end);
+
+    return (found == 2 * n) ? (end.QuadPart - begin.QuadPart) * 1e6 / frequency.QuadPart : -1;
+}
@@ -2,8 +2,11 @@
 * GameState.cpp, 8/8/2020 12:04 PM
 */
 
+#include <mutex>
 #include <queue> 
 
+#include "Camera.cpp"
+
 static std::map<string, int> game_state_offsets {
     {"name", 0x10},
 };
@@ -81,14 +84,6 @@ public:
     }
 };
 
-struct Matrix4x4 {
-    float M[4][4];
-
-    float* operator[] (int index) {
-        return M[index];
-    }
-};
-
 std::map<string, int> in_game_state_offsets {
     {"name",          0x10},
     {"load_stage1",   0x40},
@@ -114,9 +109,21 @@ public:
     unique_ptr<ServerData> sd;
     int load_stage = 0;
 
+    /* last hovered targets, kept while the cursor stays on them */
+    shared_ptr<Element> hovered_element;
+    shared_ptr<Item> hovered_item;
+    addrtype hovered_item_key[2];
+
     float width, height;
     float center_x, center_y;
 
+    /* camera snapshot, read again when it is older than camera_max_age milliseconds. */
+    Camera camera;
+    DWORD camera_time = 0;
+    DWORD camera_max_age = 10;
+    ReadBatch camera_batch;
+    std::mutex camera_mutex;
+
     InGameState(addrtype address) : GameState(address, &in_game_state_offsets)
     {
         width = read<int>("width");
@@ -173,14 +180,37 @@ public:
         return sd.get();
     }
 
-    Element* get_hovered_element() {
+    /* The hovered element is decoded again only if another element is hovered or
+       its self pointer no longer points to it. */
+    shared_ptr<Element> get_hovered_element() {
         addrtype addr = read<addrtype>("hovered");
-        return addr ? new Element(addr) : nullptr;
+        if (!addr)
+            return nullptr;
+
+        if (!hovered_element || hovered_element->address != addr
+            || hovered_element->read<addrtype>("self") != addr)
+            hovered_element = shared_ptr<Element>(new Element(addr));
+
+        return hovered_element;
     }
 
-    Item* get_hovered_item() {
+    /* The hovered item is validated by its type and component list, so an item
+       decoded at a reused address is not mistaken for the previous one, and by its
+       Mods content, so an item identified or crafted on in place is decoded again. */
+    shared_ptr<Item> get_hovered_item() {
         addrtype addr = read<addrtype>("hovered_item", 0x390);
-        return addr ? new Item(addr) : nullptr;
+        addrtype key[2];
+
+        if (!addr || !PoEMemory::read<addrtype>(addr + 0x8, key, 2))
+            return nullptr;
+
+        if (!hovered_item || hovered_item->address != addr || memcmp(key, hovered_item_key, sizeof(key))
+            || hovered_item->is_changed()) {
+            hovered_item = shared_ptr<Item>(new Item(addr));
+            memcpy(hovered_item_key, key, sizeof(key));
+        }
+
+        return hovered_item;
     }
 
     unsigned int time_in_game() {
@@ -191,20 +221,29 @@ public:
         igu.reset();
         igd.reset();
         sd.reset();
+        hovered_element.reset();
+        hovered_item.reset();
+    }
+
+    Camera get_camera() {
+        std::lock_guard<std::mutex> lock(camera_mutex);
+
+        DWORD now = GetTickCount();
+        if (!camera_time || now - camera_time > camera_max_age) {
+            camera_batch.add(address + (*offsets)["width"], &camera.size);
+            camera_batch.add(address + (*offsets)["matrix"], &camera.matrix);
+            PoEMemory::read(camera_batch);
+            camera_time = now;
+        }
+
+        return camera;
     }
 
     Vector3& transform(Vector3& vec) {
-        Point size = read<Point>("width");
-        Matrix4x4 mat = read<Matrix4x4>("matrix");
-        float x = vec.x * mat[0][0] + vec.y * mat[1][0] + vec.z * mat[2][0] + mat[3][0];
-        float y = vec.x * mat[0][1] + vec.y * mat[1][1] + vec.z * mat[2][1] + mat[3][1];
-        float z = vec.x * mat[0][2] + vec.y * mat[1][2] + vec.z * mat[2][2] + mat[3][2];
-        float w = vec.x * mat[0][3] + vec.y * mat[1][3] + vec.z * mat[2][3] + mat[3][3];
-
-        vec.x = (1.0 + x / w) * size.x / 2;
-        vec.y = (1.0 - y / w) * size.y / 2;
-        vec.z = z / w;
-
-        return vec;
+        return project(get_camera(), vec);
+    }
+
+    void project_batch(const Vector3* in, int n, Vector3* out) {
+        ::project_batch(get_camera(), in, n, out);
     }
 };
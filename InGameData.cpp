@@ -8,12 +8,122 @@
 
 #include "Terrain.cpp"
 
-using EntityList = std::unordered_map<int, shared_ptr<Entity>>;
+#include "EntityList.cpp"
+#include "FlatSet.cpp"
+
+#include "EntityTable.cpp"
+#include "EntityGrid.cpp"
+#include "EntityDecoder.cpp"
+
+/* Hot state of an entity copied from the entity table when a snapshot is published. */
+struct EntityState {
+    Point pos;
+    int life;
+    bool is_targetable;
+};
+
+/* Immutable list of the entities published once per tick. Readers on other threads
+   load it atomically and keep the entities alive as long as they hold it. */
+struct EntitySnapshot {
+    unsigned int generation;
+    std::vector<shared_ptr<Entity>> entities;
+    std::vector<EntityState> states;        /* states[i] is the state of entities[i] */
+    shared_ptr<LocalPlayer> player;
+    Point player_pos;
+};
 
 class EntitySet {
+protected:
+
+    shared_ptr<const EntitySnapshot> snapshot;
+
 public:
 
     EntityList all, removed, added;
+    EntityTable table;
+    EntityGrid grid;
+    EntityDecoder decoder;
+    unsigned int generation = 0;
+
+    void clear() {
+        std::atomic_store(&snapshot, shared_ptr<const EntitySnapshot>());
+        table.clear();
+        grid.clear();
+        all.clear();
+        removed.clear();
+        added.clear();
+    }
+
+    /* Publish the current entities, nothing is copied if neither the set nor the
+       hot state of its entities changed. */
+    void publish(shared_ptr<LocalPlayer> player = nullptr) {
+        shared_ptr<const EntitySnapshot> current = std::atomic_load(&snapshot);
+        if (current && added.empty() && removed.empty() && table.events.empty()
+            && current->player == player)
+            return;
+
+        EntitySnapshot* s = new EntitySnapshot();
+        s->generation = generation;
+        s->entities.reserve(all.size());
+        s->states.reserve(all.size());
+        for (auto& i : all) {
+            Entity* e = i.second.get();
+            s->entities.push_back(i.second);
+            if (e->slot >= 0)
+                s->states.push_back({table.grid_positions[e->slot], table.life[e->slot],
+                                     table.targetable[e->slot] != 0});
+            else
+                s->states.push_back({e->pos, -1, false});
+        }
+        s->player = player;
+        s->player_pos = player ? player->grid_position() : Point{0, 0};
+        std::atomic_store(&snapshot, shared_ptr<const EntitySnapshot>(s));
+    }
+
+    /* Returns the latest published snapshot, or null if nothing was published. */
+    shared_ptr<const EntitySnapshot> acquire() {
+        return std::atomic_load(&snapshot);
+    }
+
+    /* Refresh the hot state of the entities and the spatial index after a scan. */
+    void update() {
+        table.update(removed, added);
+        grid.update(table, removed, added);
+    }
+
+    /* Start a scan, the entities which are not stamped again are removed by end_scan(). */
+    void begin_scan() {
+        generation++;
+        removed.clear();
+        added.clear();
+    }
+
+    /* Stamp an entity already in the set, returns false if the entity is new. */
+    bool touch(int id) {
+        auto i = all.find(id);
+        if (i == all.end())
+            return false;
+
+        i->second->generation = generation;
+        return true;
+    }
+
+    void add(int id, shared_ptr<Entity>& entity) {
+        entity->generation = generation;
+        all.insert(std::make_pair(id, entity));
+        added.insert(std::make_pair(id, entity));
+    }
+
+    void end_scan() {
+        all.erase_if([&](EntityList::value_type& i) {
+            if (i.second->generation == generation)
+                return false;
+
+            removed.insert(i);
+            return true;
+        });
+        update();
+    }
 
     friend ostream& operator<<(ostream& os, EntitySet& entities)
     {
@@ -41,16 +151,116 @@ std::map<string, int> in_game_data_offsets {
 class InGameData : public RemoteMemoryObject {
 protected:
 
-    std::unordered_set<addrtype> temp_set;
-    std::unordered_set<addrtype> ignored_entity_set;
+    FlatSet<addrtype> temp_set;
+    FlatSet<int> ignored_entity_set;
     std::queue<addrtype> nodes;
+    std::vector<int> new_ids;
+    std::vector<addrtype> new_addresses;
+    std::vector<shared_ptr<Entity>> decoded;
+
+    /* New entities waiting to be decoded, carried over to the next tick when
+       the decode budget runs out. */
+    struct PendingEntity {
+        addrtype address;
+        Point pos;                  /* estimated grid position */
+        bool has_pos;
+        unsigned int generation;
+    };
+
+    std::unordered_map<int, PendingEntity> pending;
+    std::vector<std::pair<__int64, int>> decode_order;
+
+    /* last known positions of the entities, restored from the area cache */
+    std::unordered_map<int, Point> known_positions;
 
     int get_entity_id(addrtype address) {
         return PoEMemory::read<int>(address + 0x60);
     }
 
-    wstring get_entity_path(addrtype address) {
-        return PoEMemory::read<wstring>(PoEMemory::read<addrtype>(address + 0x8) + 0x8);
+    unsigned int get_entity_category(addrtype address) {
+        addrtype internal = PoEMemory::read<addrtype>(address + 0x8);
+        unsigned int category;
+
+        if (!entity_classifier.lookup(internal, category)) {
+            wstring path = PoEMemory::read<wstring>(internal + 0x8);
+            if (path[0] != L'M')
+                return CATEGORY_IGNORED;
+            category = entity_classifier.classify(internal, path);
+        }
+
+        return category;
+    }
+
+    /* Estimate the position of an entity from the component layout of its archetype. */
+    PendingEntity get_pending_entity(addrtype address) {
+        addrtype header[2];     /* internal, component_list */
+        PendingEntity p = {address, {0, 0}, false, 0};
+
+        if (PoEMemory::read<addrtype>(address + 0x8, header, 2)) {
+            shared_ptr<Archetype> archetype = entity_archetypes.find(header[0]);
+            if (archetype && archetype->positioned_index >= 0) {
+                addrtype positioned = PoEMemory::read<addrtype>(header[1] + archetype->positioned_index * 8);
+                p.pos = PoEMemory::read<Point>(positioned + positioned_component_offsets["grid_position"]);
+                p.has_pos = true;
+            }
+        }
+
+        if (!p.has_pos && !known_positions.empty()) {
+            auto i = known_positions.find(PoEMemory::read<int>(address + 0x60));
+            if (i != known_positions.end()) {
+                p.pos = i->second;
+                p.has_pos = true;
+            }
+        }
+
+        return p;
+    }
+
+    /* Decode the pending entities nearest to the player first, within the budget. */
+    void decode_pending(EntitySet& entities) {
+        Point center = player && player->positioned ? player->grid_position() : Point{0, 0};
+
+        decode_order.clear();
+        for (auto i = pending.begin(); i != pending.end();) {
+            PendingEntity& p = i->second;
+            if (p.generation != entities.generation) {
+                i = pending.erase(i);   /* gone before it was decoded */
+                continue;
+            }
+
+            /* entities of unknown types come first, they also teach the layout. */
+            __int64 dx = p.pos.x - center.x, dy = p.pos.y - center.y;
+            decode_order.push_back(std::make_pair(p.has_pos ? dx * dx + dy * dy : -1, i->first));
+            ++i;
+        }
+
+        int n = std::min((int)decode_order.size(), decode_budget);
+        std::partial_sort(decode_order.begin(), decode_order.begin() + n, decode_order.end());
+
+        /* GetTickCount() ticks every 10-16 ms, too coarse for the budget. */
+        LARGE_INTEGER frequency, start_time, now;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start_time);
+        __int64 budget = frequency.QuadPart * decode_time_budget / 1000;
+        for (int i = 0; i < n;) {
+            for (int j = 0; j < 64 && i < n; ++j, ++i) {
+                new_ids.push_back(decode_order[i].second);
+                new_addresses.push_back(pending[decode_order[i].second].address);
+            }
+
+            entities.decoder.decode(new_addresses, decoded);
+            for (int k = 0; k < decoded.size(); ++k) {
+                entities.add(new_ids[k], decoded[k]);
+                pending.erase(new_ids[k]);
+            }
+            new_ids.clear();
+            new_addresses.clear();
+            decoded.clear();
+
+            QueryPerformanceCounter(&now);
+            if (now.QuadPart - start_time.QuadPart >= budget)
+                break;
+        }
     }
 
 public:
@@ -59,6 +269,10 @@ public:
     shared_ptr<LocalPlayer> player;
     shared_ptr<Terrain> terrain;
     bool force_reset = false;
+    int decode_budget = 512;        /* maximum entities decoded per tick */
+    int decode_time_budget = 25;    /* milliseconds */
+    int max_nodes = 0;              /* node limit of the last scan */
+    bool truncated = false;         /* the last scan hit the node limit */
 
     InGameData(addrtype address) : RemoteMemoryObject(address, &in_game_data_offsets)
     {
@@ -68,6 +282,18 @@ public:
         nodes = {};
     }
 
+    int pending_count() {
+        return pending.size();
+    }
+
+    FlatSet<int>& get_ignored_entities() {
+        return ignored_entity_set;
+    }
+
+    void set_known_positions(std::unordered_map<int, Point>& positions) {
+        known_positions = positions;
+    }
+
     int area_hash() {
         return read<int>("area_hash");
     }
@@ -98,10 +324,15 @@ public:
         return terrain.get();
     }
 
-    int get_all_entities(EntitySet& entities, std::wregex& ignored_exp) {
-        entities.removed.clear();
-        entities.removed.swap(entities.all);
-        entities.added.clear();
+    int get_all_entities(EntitySet& entities) {
+        entities.begin_scan();
+
+        /* the tree has one node per entity plus the head, the limit only guards
+           against walking garbage while the list is being modified. */
+        int count = read<int>("entity_list_count");
+        max_nodes = std::min(std::max(count, 0) + count / 4 + 64, 1 << 20);
+        truncated = false;
+        temp_set.reserve(max_nodes);
 
         addrtype addr = read<addrtype>("entity_list", "root");
         temp_set.insert(addr);
@@ -117,10 +348,15 @@ public:
 
             for (int offset : (int[]){0x0, 0x10}) {
                 addr = PoEMemory::read<addrtype>(node + offset);
-                if (temp_set.count(addr) == 0 && temp_set.size() < 2048) {
-                    nodes.push(addr);
-                    temp_set.insert(addr);
+                if (temp_set.count(addr))
+                    continue;
+
+                if (temp_set.size() >= max_nodes) {
+                    truncated = true;
+                    continue;
                 }
+                nodes.push(addr);
+                temp_set.insert(addr);
             }
 
             addrtype entity_address = PoEMemory::read<addrtype>(node + 0x28);
@@ -133,29 +369,30 @@ public:
             if (ignored_entity_set.count(entity_id))
                 continue;
 
-            auto i = entities.removed.find(entity_id);
-            if (i != entities.removed.end()) {
-                entities.all.insert(*i);
-                entities.removed.erase(i);
+            if (entities.touch(entity_id))
+                continue;
+
+            auto i = pending.find(entity_id);
+            if (i != pending.end()) {
+                i->second.generation = entities.generation;
                 continue;
             }
 
-            wstring path = get_entity_path(entity_address);
-            if (path[0] != L'M' || std::regex_search(path, ignored_exp)) {
+            if (get_entity_category(entity_address) & CATEGORY_IGNORED) {
                 ignored_entity_set.insert(entity_id);
                 continue;
             }
 
-            std::shared_ptr<Entity> entity(new Entity(entity_address));
-            entities.all.insert(std::make_pair(entity_id, entity));
-            entities.added.insert(std::make_pair(entity_id, entity));
-
-            // Limit the maximum entities found.
-            if (entities.added.size() > 2048)
-                break;
+            PendingEntity p = get_pending_entity(entity_address);
+            p.generation = entities.generation;
+            pending[entity_id] = p;
         }
         temp_set.clear();
 
-        return read<int>("entity_list_count");
+        /* decode the new entities, in parallel if there are many of them. */
+        decode_pending(entities);
+        entities.end_scan();
+
+        return count;
     }
 };
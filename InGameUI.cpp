@@ -2,8 +2,10 @@
 * InGameUI.cpp, 8/18/2020 6:46 PM
 */
 
+#include <mutex>
 #include <unordered_map>
 
+#include "TextIndex.cpp"
 #include "ui/Inventory.cpp"
 #include "ui/Stash.cpp"
 #include "ui/Vendor.cpp"
@@ -48,6 +50,21 @@ enum {
     StashIndex      = 33,
 };
 
+/* Node of the ground label list */
+struct LabelNode {
+    addrtype next;
+    addrtype prev;
+    addrtype entity;
+    addrtype label;
+};
+
+/* Label read in the visibility pass */
+struct LabelInfo {
+    LabelNode node;
+    byte flags;
+    int entity_id;
+};
+
 class InGameUI : public Element {
 public:
 
@@ -63,7 +80,16 @@ public:
     unique_ptr<Favours> favours;
     unique_ptr<Atlas> atlas;
     unique_ptr<Skills> skills;
-    shared_ptr<Entity> nearest_entity;
+
+    /* label elements by address, reused while the labels stay on the ground.
+       The scan state is shared by all the scans, label_mutex is held for a scan. */
+    std::mutex label_mutex;
+    std::unordered_map<addrtype, shared_ptr<Element>> labels;
+    std::vector<LabelInfo> label_infos;
+    ReadBatch label_batch;
+    unsigned int label_generation = 0;
+    int max_labels = 2048;                  /* raised to the entity count by PoETask */
+    bool labels_truncated = false;
 
     InGameUI(addrtype address) : Element(address, &in_game_ui_offsets) {
         get_inventory();
@@ -189,58 +215,61 @@ public:
         return skills.get();
     }
 
-    int get_all_entities(EntityList& entities, EntityList& removed) {
-        entities.swap(removed);
-        entities.clear();
+    shared_ptr<Element>& get_label(addrtype address) {
+        shared_ptr<Element>& label = labels[address];
+        if (!label)
+            label = shared_ptr<Element>(new Element(address));
+        return label;
+    }
+
+    int get_all_entities(EntitySet& entities) {
+        std::lock_guard<std::mutex> lock(label_mutex);
+        entities.begin_scan();
+
+        /* walk the list reading each node whole, then read the visibility flags
+           and the entity ids of all the labels in one batch. */
         addrtype root = read<addrtype>("entity_list", "root");
-        addrtype next = root;
+        addrtype next = PoEMemory::read<addrtype>(root);
 
-        while (1) {
-            next = PoEMemory::read<addrtype>(next);
-            if (!next || next == root)
+        label_infos.clear();
+        while (next && next != root && label_infos.size() < max_labels) {
+            LabelInfo info = {};
+            if (!PoEMemory::read<LabelNode>(next, &info.node, 1))
                 break;
+            label_infos.push_back(info);
+            next = info.node.next;
+        }
+        labels_truncated = (label_infos.size() >= max_labels && next && next != root);
 
-            addrtype label = PoEMemory::read<addrtype>(next + 0x18);
-            bool is_visible = PoEMemory::read<byte>(label + 0x119) & 0x8;
-            if (!is_visible)
-                continue;
+        for (auto& i : label_infos) {
+            label_batch.add(i.node.label + 0x119, &i.flags);
+            label_batch.add(i.node.entity + 0x60, &i.entity_id);
+        }
+        PoEMemory::read(label_batch);
 
-            addrtype entity_address = PoEMemory::read<addrtype>(next + 0x10);
-            int entity_id = PoEMemory::read<int>(entity_address + 0x60);
-            auto i = removed.find(entity_id);
-            if (i != removed.end()) {
-                entities.insert(*i);
-                removed.erase(i);
+        for (auto& i : label_infos) {
+            if (!(i.flags & 0x8))
                 continue;
-            }
 
-            std::shared_ptr<Entity> entity(new Entity(entity_address));
-            entity->label = shared_ptr<Element>(new Element(label));
-            entities.insert(std::make_pair(entity_id, entity));
+            if (entities.touch(i.entity_id))
+                continue;
 
-            // Limit the maximum entities found.
-            if (entities.size() > 2048)
-                break;
+            std::shared_ptr<Entity> entity(new Entity(i.node.entity));
+            entity->label = get_label(i.node.label);
+            entities.add(i.entity_id, entity);
         }
-
-        return entities.size();
-    }
-
-    shared_ptr<Entity>& get_nearest_entity(LocalPlayer& player, wstring text) {
-        unsigned int dist, max_dist = -1;
-        EntityList entities, removed;
-
-        get_all_entities(entities, removed);
-        nearest_entity = nullptr;
-        for (auto i : entities) {
-            if ((dist = player.dist(*i.second)) < max_dist) {
-                if (i.second->name().find(text) != -1 || i.second->path.find(text) != -1) {
-                    nearest_entity = i.second;
-                    max_dist = dist;
-                }
+        entities.end_scan();
+
+        /* drop the labels which are no longer used by any entity */
+        if (++label_generation % 16 == 0) {
+            for (auto i = labels.begin(); i != labels.end();) {
+                if (i->second.use_count() == 1)
+                    i = labels.erase(i);
+                else
+                    ++i;
             }
         }
 
-        return nearest_entity;
+        return entities.all.size();
     }
 };
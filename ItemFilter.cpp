@@ -0,0 +1,657 @@
+/*
+* ItemFilter.cpp, 10/20/2026 12:30 AM
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+/* Aho-Corasick automaton over any number of literals with sparse transitions,
+   match() reports the index of every literal found in a string. */
+class MultiLiteralMatcher {
+protected:
+
+    struct State {
+        std::vector<std::pair<wchar_t, int>> next;     /* sorted by character */
+        int fail = 0;
+        int output = -1;                               /* literal ending here */
+        int dict = -1;                                 /* next state with an output by fail links */
+    };
+
+    std::vector<State> states;
+    int literal_count = 0;
+
+    int go(int s, wchar_t c) {
+        auto& next = states[s].next;
+        auto i = std::lower_bound(next.begin(), next.end(), std::make_pair(c, -1));
+        return (i != next.end() && i->first == c) ? i->second : -1;
+    }
+
+public:
+
+    MultiLiteralMatcher() {
+        clear();
+    }
+
+    int size() {
+        return literal_count;
+    }
+
+    void clear() {
+        states.clear();
+        states.push_back(State());
+        literal_count = 0;
+    }
+
+    /* Returns the index of the literal, equal literals share their index. */
+    int add(const wstring& literal) {
+        int s = 0;
+
+        for (wchar_t c : literal) {
+            int t = go(s, c);
+            if (t < 0) {
+                t = states.size();
+                states.push_back(State());
+                auto& next = states[s].next;
+                next.insert(std::lower_bound(next.begin(), next.end(), std::make_pair(c, -1)),
+                            std::make_pair(c, t));
+            }
+            s = t;
+        }
+
+        if (states[s].output < 0)
+            states[s].output = literal_count++;
+
+        return states[s].output;
+    }
+
+    void compile() {
+        std::vector<int> queue;
+
+        for (auto& i : states[0].next) {
+            states[i.second].fail = 0;
+            queue.push_back(i.second);
+        }
+
+        for (int k = 0; k < queue.size(); ++k) {
+            int s = queue[k];
+            for (auto& i : states[s].next) {
+                int t = i.second, f = states[s].fail, g;
+                while ((g = go(f, i.first)) < 0 && f != 0)
+                    f = states[f].fail;
+                states[t].fail = (g >= 0 && g != t) ? g : 0;
+
+                int fail = states[t].fail;
+                states[t].dict = (states[fail].output >= 0) ? fail : states[fail].dict;
+                queue.push_back(t);
+            }
+        }
+    }
+
+    template <typename F> void match(const wstring& str, F func) {
+        int s = 0;
+
+        for (wchar_t c : str) {
+            int t;
+            while ((t = go(s, c)) < 0 && s != 0)
+                s = states[s].fail;
+            s = (t < 0) ? 0 : t;
+
+            for (int o = (states[s].output >= 0) ? s : states[s].dict; o >= 0; o = states[o].dict)
+                func(states[o].output);
+        }
+    }
+};
+
+/* Item fields used by the filter rules, decoded once per item. */
+struct ItemFields {
+    wstring base_type;
+    wstring item_class;
+    int values[16];             /* indexed by FilterField */
+};
+
+enum FilterField {
+    FIELD_RARITY,
+    FIELD_ITEM_LEVEL,
+    FIELD_QUALITY,
+    FIELD_SOCKETS,
+    FIELD_LINKED_SOCKETS,
+    FIELD_STACK_SIZE,
+    FIELD_GEM_LEVEL,
+    FIELD_MAP_TIER,
+    FIELD_WIDTH,
+    FIELD_HEIGHT,
+    FIELD_INFLUENCE,            /* bits in the order of the influence names */
+    FIELD_CORRUPTED,
+    FIELD_IDENTIFIED,
+    FIELD_MIRRORED,
+    FIELD_SYNTHESISED,
+    FIELD_FRACTURED,
+};
+
+enum FilterOperator {
+    FILTER_EQUAL,
+    FILTER_NOT_EQUAL,
+    FILTER_LESS,
+    FILTER_LESS_EQUAL,
+    FILTER_GREATER,
+    FILTER_GREATER_EQUAL,
+    FILTER_ANY_BITS,            /* any of the bits, or none at all if the mask is 0 */
+    FILTER_NO_BITS,
+};
+
+struct FilterCondition {
+    int field;
+    int op;
+    std::vector<int> values;
+
+    bool test(int value) const {
+        switch (op) {
+        case FILTER_EQUAL:
+            return std::find(values.begin(), values.end(), value) != values.end();
+        case FILTER_NOT_EQUAL:
+            return std::find(values.begin(), values.end(), value) == values.end();
+        case FILTER_LESS:
+            return value < values[0];
+        case FILTER_LESS_EQUAL:
+            return value <= values[0];
+        case FILTER_GREATER:
+            return value > values[0];
+        case FILTER_GREATER_EQUAL:
+            return value >= values[0];
+        case FILTER_ANY_BITS:
+            return values[0] ? (value & values[0]) != 0 : value == 0;
+        case FILTER_NO_BITS:
+            return (value & values[0]) == 0;
+        }
+
+        return false;
+    }
+};
+
+struct FilterRule {
+    bool show;
+    bool is_continue = false;
+    int line;
+    std::vector<FilterCondition> conditions;
+    std::vector<int> string_conditions;         /* indices into the string condition bits */
+};
+
+/* Path fragments of the item classes, the first match is taken. */
+static std::vector<std::pair<const wchar_t*, const wchar_t*>> item_classes = {
+    {L"/Currency/",                 L"Stackable Currency"},
+    {L"/DivinationCards/",          L"Divination Card"},
+    {L"/MapFragments/",             L"Map Fragments"},
+    {L"/Maps/",                     L"Maps"},
+    {L"/Gems/SupportGem",           L"Support Skill Gems"},
+    {L"/Gems/",                     L"Active Skill Gems"},
+    {L"/Rings/",                    L"Rings"},
+    {L"/Amulets/",                  L"Amulets"},
+    {L"/Belts/",                    L"Belts"},
+    {L"/Jewels/JewelAbyss",         L"Abyss Jewel"},
+    {L"/Jewels/",                   L"Jewel"},
+    {L"/Flasks/FlaskLife",          L"Life Flasks"},
+    {L"/Flasks/FlaskMana",          L"Mana Flasks"},
+    {L"/Flasks/FlaskHybrid",        L"Hybrid Flasks"},
+    {L"/Flasks/",                   L"Utility Flasks"},
+    {L"/BodyArmours/",              L"Body Armours"},
+    {L"/Boots/",                    L"Boots"},
+    {L"/Gloves/",                   L"Gloves"},
+    {L"/Helmets/",                  L"Helmets"},
+    {L"/Shields/",                  L"Shields"},
+    {L"/Quivers/",                  L"Quivers"},
+    {L"/Claws/",                    L"Claws"},
+    {L"/Daggers/Rune",              L"Rune Daggers"},
+    {L"/Daggers/",                  L"Daggers"},
+    {L"/Wands/",                    L"Wands"},
+    {L"/OneHandSwords/",            L"One Hand Swords"},
+    {L"/OneHandThrustingSwords/",   L"Thrusting One Hand Swords"},
+    {L"/OneHandAxes/",              L"One Hand Axes"},
+    {L"/OneHandMaces/Sceptre",      L"Sceptres"},
+    {L"/OneHandMaces/",             L"One Hand Maces"},
+    {L"/Bows/",                     L"Bows"},
+    {L"/Staves/Warstaff",           L"Warstaves"},
+    {L"/Staves/",                   L"Staves"},
+    {L"/TwoHandSwords/",            L"Two Hand Swords"},
+    {L"/TwoHandAxes/",              L"Two Hand Axes"},
+    {L"/TwoHandMaces/",             L"Two Hand Maces"},
+    {L"/FishingRods/",              L"Fishing Rods"},
+    {L"/QuestItems/",               L"Quest Items"},
+    {L"/Heist/HeistContract",       L"Contract"},
+    {L"/Heist/HeistBlueprint",      L"Blueprint"},
+    {L"/Heist/",                    L"Heist Gear"},
+    {L"/Incubation/",               L"Incubator"},
+};
+
+static const wchar_t* filter_influence_names[] = {L"shaper", L"elder", L"crusader", L"redeemer", L"hunter", L"warlord"};
+
+/* Item filter compiled from the game's .filter syntax. BaseType and Class values
+   go through one matcher each, so the string conditions of all the rules are
+   tested in a single pass over the item's names. */
+class ItemFilter {
+protected:
+
+    MultiLiteralMatcher base_type_matcher, class_matcher;
+    std::vector<std::vector<int>> base_type_literals, class_literals;  /* literal -> string conditions */
+    int string_condition_count = 0;
+    std::vector<unsigned __int64> matched;
+
+    /* Rules are only tested if they can match: the rules without string conditions
+       always are, the others when the first of their string conditions matched. */
+    std::vector<unsigned __int64> unconditional_rules;
+    std::vector<std::vector<int>> condition_rules;  /* string condition -> rules */
+    std::vector<unsigned __int64> candidates;
+
+    static wstring to_lower(const wstring& str) {
+        wstring s = str;
+        for (auto& c : s) {
+            if (c >= L'A' && c <= L'Z')
+                c += L'a' - L'A';
+        }
+        return s;
+    }
+
+    /* exact values are delimited, so they can only match a whole name. */
+    static wstring exact(const wstring& str) {
+        return L"\x02" + str + L"\x03";
+    }
+
+    static std::vector<wstring> tokenize(const wstring& line) {
+        std::vector<wstring> tokens;
+        int i = 0, n = line.size();
+
+        while (i < n) {
+            if (iswspace(line[i])) {
+                ++i;
+            } else if (line[i] == L'#') {
+                break;
+            } else if (line[i] == L'"') {
+                int j = line.find(L'"', i + 1);
+                if (j < 0)
+                    j = n;
+                tokens.push_back(line.substr(i + 1, j - i - 1));
+                i = j + 1;
+            } else {
+                int j = i;
+                while (j < n && !iswspace(line[j]) && line[j] != L'"')
+                    ++j;
+                tokens.push_back(line.substr(i, j - i));
+                i = j;
+            }
+        }
+
+        return tokens;
+    }
+
+    /* An operator may be written with its value, e.g. "ItemLevel >=75". */
+    static void split_operator(std::vector<wstring>& tokens) {
+        if (tokens.size() < 2)
+            return;
+
+        int n = tokens[1].find_first_not_of(L"<>=!");
+        if (n > 0 && n != wstring::npos) {
+            tokens.insert(tokens.begin() + 2, tokens[1].substr(n));
+            tokens[1].resize(n);
+        }
+    }
+
+    /* Numbers with a suffix, like the colours of "Sockets >= 5GGG", are not supported. */
+    static bool parse_int(const wstring& value, int& n) {
+        wchar_t* end;
+
+        n = wcstol(value.c_str(), &end, 10);
+        return end != value.c_str() && *end == L'\0';
+    }
+
+    static int parse_operator(std::vector<wstring>& tokens, int& index) {
+        const wchar_t* names[] = {L"=", L"!=", L"<", L"<=", L">", L">="};
+
+        if (index < tokens.size()) {
+            if (tokens[index] == L"==") {
+                ++index;
+                return FILTER_EQUAL;
+            }
+            for (int i = 0; i < 6; ++i) {
+                if (tokens[index] == names[i]) {
+                    ++index;
+                    return i;
+                }
+            }
+        }
+
+        return FILTER_EQUAL;
+    }
+
+    static int parse_rarity(const wstring& value) {
+        const wchar_t* names[] = {L"normal", L"magic", L"rare", L"unique"};
+        wstring s = to_lower(value);
+
+        for (int i = 0; i < 4; ++i) {
+            if (s == names[i])
+                return i;
+        }
+
+        int n;
+        return parse_int(value, n) ? n : -1;
+    }
+
+    void add_string_condition(FilterRule& rule, MultiLiteralMatcher& matcher,
+                              std::vector<std::vector<int>>& literals,
+                              std::vector<wstring>& values, bool is_exact)
+    {
+        int id = string_condition_count++;
+
+        for (auto& v : values) {
+            int i = matcher.add(is_exact ? exact(to_lower(v)) : to_lower(v));
+            if (i >= literals.size())
+                literals.resize(i + 1);
+            literals[i].push_back(id);
+        }
+        rule.string_conditions.push_back(id);
+    }
+
+    /* Returns false if the keyword is not a supported condition. */
+    bool parse_condition(FilterRule& rule, std::vector<wstring>& tokens) {
+        std::vector<std::pair<const wchar_t*, int>> numeric_fields = {
+            {L"ItemLevel", FIELD_ITEM_LEVEL}, {L"Quality", FIELD_QUALITY},
+            {L"Sockets", FIELD_SOCKETS}, {L"LinkedSockets", FIELD_LINKED_SOCKETS},
+            {L"StackSize", FIELD_STACK_SIZE}, {L"GemLevel", FIELD_GEM_LEVEL},
+            {L"MapTier", FIELD_MAP_TIER}, {L"Width", FIELD_WIDTH}, {L"Height", FIELD_HEIGHT},
+        };
+        std::vector<std::pair<const wchar_t*, int>> bool_fields = {
+            {L"Corrupted", FIELD_CORRUPTED}, {L"Identified", FIELD_IDENTIFIED},
+            {L"Mirrored", FIELD_MIRRORED}, {L"SynthesisedItem", FIELD_SYNTHESISED},
+            {L"FracturedItem", FIELD_FRACTURED},
+        };
+        wstring& keyword = tokens[0];
+        int index = 1;
+
+        split_operator(tokens);
+        if (keyword == L"BaseType" || keyword == L"Class") {
+            bool is_exact = (index < tokens.size() && tokens[index] == L"==");
+            int op = parse_operator(tokens, index);
+            std::vector<wstring> values(tokens.begin() + index, tokens.end());
+            if (op != FILTER_EQUAL || values.empty())
+                return false;
+
+            if (keyword == L"BaseType")
+                add_string_condition(rule, base_type_matcher, base_type_literals, values, is_exact);
+            else
+                add_string_condition(rule, class_matcher, class_literals, values, is_exact);
+            return true;
+        }
+
+        if (keyword == L"Rarity") {
+            FilterCondition c = {FIELD_RARITY, parse_operator(tokens, index)};
+            for (; index < tokens.size(); ++index) {
+                int rarity = parse_rarity(tokens[index]);
+                if (rarity < 0)
+                    return false;
+                c.values.push_back(rarity);
+            }
+            if (c.values.empty())
+                return false;
+            rule.conditions.push_back(c);
+            return true;
+        }
+
+        for (auto& i : numeric_fields) {
+            if (keyword == i.first) {
+                FilterCondition c = {i.second, parse_operator(tokens, index)};
+                for (; index < tokens.size(); ++index) {
+                    int value;
+                    if (!parse_int(tokens[index], value))
+                        return false;
+                    c.values.push_back(value);
+                }
+                if (c.values.empty())
+                    return false;
+                rule.conditions.push_back(c);
+                return true;
+            }
+        }
+
+        for (auto& i : bool_fields) {
+            if (keyword == i.first) {
+                if (parse_operator(tokens, index) != FILTER_EQUAL || index >= tokens.size())
+                    return false;
+                int value = to_lower(tokens[index]) == L"true";
+                rule.conditions.push_back({i.second, FILTER_EQUAL, {value}});
+                return true;
+            }
+        }
+
+        if (keyword == L"HasInfluence" || keyword == L"ShaperItem" || keyword == L"ElderItem") {
+            int mask = 0;
+            if (parse_operator(tokens, index) != FILTER_EQUAL)
+                return false;
+            if (keyword == L"HasInfluence") {
+                for (; index < tokens.size(); ++index) {
+                    for (int i = 0; i < 6; ++i) {
+                        if (to_lower(tokens[index]) == filter_influence_names[i])
+                            mask |= 1 << i;
+                    }
+                }
+                rule.conditions.push_back({FIELD_INFLUENCE, FILTER_ANY_BITS, {mask}});
+            } else {
+                mask = (keyword == L"ShaperItem") ? 0x1 : 0x2;
+                bool value = (index < tokens.size() && to_lower(tokens[index]) == L"true");
+                rule.conditions.push_back({FIELD_INFLUENCE, value ? FILTER_ANY_BITS : FILTER_NO_BITS, {mask}});
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+public:
+
+    std::vector<FilterRule> rules;
+    wstring file_name;
+    int unsupported = 0;            /* conditions ignored by the last load() */
+    std::vector<wstring> unsupported_keywords;      /* their keywords, once each */
+
+    int size() {
+        return rules.size();
+    }
+
+    void clear() {
+        rules.clear();
+        base_type_matcher.clear();
+        class_matcher.clear();
+        base_type_literals.clear();
+        class_literals.clear();
+        string_condition_count = 0;
+        unsupported = 0;
+        unsupported_keywords.clear();
+        unconditional_rules.clear();
+        condition_rules.clear();
+    }
+
+    /* Parses the filter, the actions of the blocks are ignored except Continue. */
+    bool parse(std::wistream& is) {
+        const wchar_t* actions[] = {L"Set", L"Play", L"Minimap", L"Custom", L"Disable", L"Enable"};
+        FilterRule* rule = nullptr;
+        wstring line;
+        int line_number = 0;
+
+        clear();
+        while (std::getline(is, line)) {
+            std::vector<wstring> tokens = tokenize(line);
+            line_number++;
+            if (tokens.empty())
+                continue;
+
+            wstring keyword = tokens[0];
+            if (keyword == L"Show" || keyword == L"Hide" || keyword == L"Minimal") {
+                rules.push_back(FilterRule());
+                rule = &rules.back();
+                rule->show = (keyword != L"Hide");
+                rule->line = line_number;
+            } else if (!rule) {
+                continue;
+            } else if (keyword == L"Continue") {
+                rule->is_continue = true;
+            } else if (std::none_of(actions, actions + 6, [&](const wchar_t* a) {return keyword.find(a) == 0;})) {
+                /* an unsupported condition is not a constraint, so the verdict
+                   of the block is the same as the game's when it holds. */
+                if (!parse_condition(*rule, tokens)) {
+                    unsupported++;
+                    if (std::find(unsupported_keywords.begin(), unsupported_keywords.end(), keyword)
+                        == unsupported_keywords.end())
+                        unsupported_keywords.push_back(keyword);
+                }
+            }
+        }
+
+        base_type_matcher.compile();
+        class_matcher.compile();
+        matched.resize((string_condition_count + 63) / 64);
+
+        unconditional_rules.assign((rules.size() + 63) / 64, 0);
+        condition_rules.resize(string_condition_count);
+        for (int i = 0; i < rules.size(); ++i) {
+            if (rules[i].string_conditions.empty())
+                unconditional_rules[i >> 6] |= 1ull << (i & 63);
+            else
+                condition_rules[rules[i].string_conditions[0]].push_back(i);
+        }
+
+        return !rules.empty();
+    }
+
+    /* The filter files are UTF-8, they are read whole and converted before parsing. */
+    bool load(const wstring& file_name) {
+        FILE* file = _wfopen(file_name.c_str(), L"rb");
+        if (!file)
+            return false;
+
+        string text;
+        char buffer[4096];
+        int n;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            text.append(buffer, n);
+        fclose(file);
+
+        if (text.compare(0, 3, "\xef\xbb\xbf") == 0)
+            text.erase(0, 3);
+        wstring wide_text(text.size(), L'\0');
+        n = MultiByteToWideChar(CP_UTF8, 0, text.data(), text.size(), &wide_text[0], wide_text.size());
+        wide_text.resize(n);
+
+        std::wistringstream is(wide_text);
+        this->file_name = file_name;
+        return parse(is);
+    }
+
+    /* Returns the index of the rule deciding the item, -1 if no rule matched. */
+    int evaluate(ItemFields& fields) {
+        int result = -1;
+        auto set_matched = [&](int id) {
+            matched[id >> 6] |= 1ull << (id & 63);
+            for (int i : condition_rules[id])
+                candidates[i >> 6] |= 1ull << (i & 63);
+        };
+
+        std::fill(matched.begin(), matched.end(), 0);
+        candidates = unconditional_rules;
+        base_type_matcher.match(exact(to_lower(fields.base_type)), [&](int literal) {
+            for (int id : base_type_literals[literal])
+                set_matched(id);
+        });
+        class_matcher.match(exact(to_lower(fields.item_class)), [&](int literal) {
+            for (int id : class_literals[literal])
+                set_matched(id);
+        });
+
+        /* the candidates are tested in the order of the rules. */
+        for (int w = 0; w < candidates.size(); ++w) {
+            for (unsigned __int64 bits = candidates[w]; bits; bits &= bits - 1) {
+                int i = (w << 6) + __builtin_ctzll(bits);
+                FilterRule& rule = rules[i];
+                bool is_matched = true;
+
+                for (int id : rule.string_conditions) {
+                    if (!(matched[id >> 6] & (1ull << (id & 63)))) {
+                        is_matched = false;
+                        break;
+                    }
+                }
+
+                for (int k = 0; is_matched && k < rule.conditions.size(); ++k)
+                    is_matched = rule.conditions[k].test(fields.values[rule.conditions[k].field]);
+
+                if (is_matched) {
+                    result = i;
+                    if (!rule.is_continue)
+                        return result;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /* Items which match no rule are shown like in the game. */
+    bool is_shown(ItemFields& fields) {
+        int i = evaluate(fields);
+        return i < 0 || rules[i].show;
+    }
+
+    /* Debug routine, returns the average microseconds taken to evaluate a screen
+       of n synthetic items, which cycle through the item classes. */
+    float benchmark(int n, int rounds = 1000) {
+        std::vector<ItemFields> items(n);
+        LARGE_INTEGER frequency, begin, end;
+
+        for (int i = 0; i < n; ++i) {
+            items[i].base_type = L"Item " + std::to_wstring(i);
+            items[i].item_class = item_classes[i % item_classes.size()].second;
+            for (int k = 0; k < 16; ++k)
+                items[i].values[k] = (i + k) % 7;
+            items[i].values[FIELD_RARITY] = i % 4;
+            items[i].values[FIELD_ITEM_LEVEL] = 60 + i % 27;
+        }
+
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&begin);
+        for (int r = 0; r < rounds; ++r) {
+            for (auto& fields : items)
+                is_shown(fields);
+        }
+        QueryPerformanceCounter(&end);
+
+        return (end.QuadPart - begin.QuadPart) * 1e6 / frequency.QuadPart / rounds;
+    }
+};
+
+/* Decode the fields of an item used by the filter rules. */
+void get_item_fields(Item& item, ItemFields& fields) {
+    fields.base_type = item.base_name();
+    fields.item_class.clear();
+    for (auto& i : item_classes) {
+        if (item.path.find(i.first) != wstring::npos) {
+            fields.item_class = i.second;
+            break;
+        }
+    }
+
+    int* v = fields.values;
+    v[FIELD_RARITY] = item.get_rarity();
+    v[FIELD_ITEM_LEVEL] = item.get_item_level();
+    v[FIELD_QUALITY] = item.get_quality();
+    v[FIELD_SOCKETS] = item.get_sockets();
+    v[FIELD_LINKED_SOCKETS] = item.get_links();
+    v[FIELD_STACK_SIZE] = item.get_stack_count();
+    v[FIELD_GEM_LEVEL] = item.get_level();
+    v[FIELD_MAP_TIER] = item.get_tier();
+    v[FIELD_WIDTH] = item.get_width();
+    v[FIELD_HEIGHT] = item.get_height();
+    v[FIELD_INFLUENCE] = item.get_influence_type();
+    v[FIELD_CORRUPTED] = item.is_corrupted();
+    v[FIELD_IDENTIFIED] = item.is_identified();
+    v[FIELD_MIRRORED] = item.is_mirrored();
+    v[FIELD_SYNTHESISED] = item.is_synthesised();
+    v[FIELD_FRACTURED] = item.is_fractured();
+}
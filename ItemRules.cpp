@@ -0,0 +1,421 @@
+/*
+* ItemRules.cpp, 10/20/2026 2:10 AM
+*/
+
+#include <algorithm>
+#include <regex>
+#include <vector>
+
+/* Item properties known to the compiled rules, the names are those of the
+   AutoHotkey item objects. */
+enum ItemRuleKey {
+    RULE_BASE_TYPE,
+    RULE_SUB_TYPE,
+    RULE_GRIP_TYPE,
+    RULE_BASE_NAME,
+    RULE_NAME,
+    RULE_INDEX,
+    RULE_RARITY,
+    RULE_ITEM_LEVEL,
+    RULE_QUALITY,
+    RULE_SOCKETS,
+    RULE_LINKS,
+    RULE_TIER,
+    RULE_LEVEL,
+    RULE_STACK_COUNT,
+    RULE_CHARGES,
+    RULE_WIDTH,
+    RULE_HEIGHT,
+    RULE_IS_IDENTIFIED,
+    RULE_IS_MIRRORED,
+    RULE_IS_CORRUPTED,
+    RULE_IS_RGB,
+    RULE_IS_TYPE,           /* is<BaseType> or is<SubType> */
+    RULE_STAT,              /* stat.<id>, the value of a numeric stat */
+    RULE_TEXT_KEYS = RULE_INDEX,
+};
+
+static std::vector<std::pair<const wchar_t*, ItemRuleKey>> item_rule_keys = {
+    {L"baseType",     RULE_BASE_TYPE},
+    {L"subType",      RULE_SUB_TYPE},
+    {L"gripType",     RULE_GRIP_TYPE},
+    {L"baseName",     RULE_BASE_NAME},
+    {L"name",         RULE_NAME},
+    {L"index",        RULE_INDEX},
+    {L"rarity",       RULE_RARITY},
+    {L"itemLevel",    RULE_ITEM_LEVEL},
+    {L"quality",      RULE_QUALITY},
+    {L"sockets",      RULE_SOCKETS},
+    {L"links",        RULE_LINKS},
+    {L"tier",         RULE_TIER},
+    {L"level",        RULE_LEVEL},
+    {L"stackCount",   RULE_STACK_COUNT},
+    {L"charges",      RULE_CHARGES},
+    {L"width",        RULE_WIDTH},
+    {L"height",       RULE_HEIGHT},
+    {L"isIdentified", RULE_IS_IDENTIFIED},
+    {L"isMirrored",   RULE_IS_MIRRORED},
+    {L"isCorrupted",  RULE_IS_CORRUPTED},
+    {L"isRGB",        RULE_IS_RGB},
+};
+
+/* Splits the metadata path of an item into the base type and sub type used by
+   Item.ahk, e.g. Metadata/Items/Armours/BodyArmours/... is Armour, BodyArmour. */
+void get_item_type(const wstring& path, wstring& base_type, wstring& sub_type, wstring& grip_type) {
+    static const wstring prefix = L"Metadata/Items/";
+
+    base_type.clear();
+    sub_type.clear();
+    grip_type.clear();
+
+    int begin = path.find(prefix);
+    if (begin == wstring::npos)
+        return;
+
+    begin += prefix.size();
+    int end = path.find(L'/', begin);
+    if (end == wstring::npos)
+        return;
+
+    wstring dir = path.substr(begin, end - begin);
+    int next = path.find(L'/', end + 1);
+    wstring name = path.substr(end + 1, (next == wstring::npos) ? wstring::npos : next - end - 1);
+
+    if (dir.size() > 1 && dir.back() == L's') {
+        base_type = dir.substr(0, dir.size() - 1);
+        wstring type = name;
+        if (type != L"Gloves" && type != L"Boots" && type.size() > 2 && type.back() == L's')
+            type.pop_back();
+
+        if (base_type == L"Weapon")
+            grip_type = (type == L"OneHandWeapon") ? L"1H" : L"2H";
+        else if (base_type == L"Armour")
+            sub_type = type;
+        else if (dir == L"AtlasExiles")
+            base_type = L"Currency";
+        else if (dir == L"Metamorphosis")
+            base_type = L"Metamorph";
+    } else {
+        base_type = dir;
+        if (name == L"HeistCoin")
+            base_type = L"Currency";
+        else if (name.find(L"Prophecy") != wstring::npos)
+            base_type = L"Prophecy";
+        else if (name.find(L"CapturedMonster") != wstring::npos)
+            base_type = L"Beast";
+    }
+}
+
+/* Properties of one item, read only when a rule asks for them. */
+class ItemRuleFields {
+protected:
+
+    Item* item;
+    int index;
+    unsigned int loaded = 0;
+    wstring texts[RULE_TEXT_KEYS];
+    wstring number_text;
+    double numbers[RULE_IS_TYPE];
+
+public:
+
+    ItemRuleFields(Item& item, int index) : item(&item), index(index) {
+    }
+
+    const wstring& text(ItemRuleKey key) {
+        if (key >= RULE_TEXT_KEYS) {
+            number_text = std::to_wstring((int)number(key));
+            return number_text;
+        }
+
+        if (!(loaded & (1 << key))) {
+            switch (key) {
+            case RULE_BASE_TYPE:
+            case RULE_SUB_TYPE:
+            case RULE_GRIP_TYPE:
+                get_item_type(item->path, texts[RULE_BASE_TYPE], texts[RULE_SUB_TYPE], texts[RULE_GRIP_TYPE]);
+                loaded |= (1 << RULE_BASE_TYPE) | (1 << RULE_SUB_TYPE) | (1 << RULE_GRIP_TYPE);
+                break;
+            case RULE_BASE_NAME: texts[key] = item->base_name(); break;
+            case RULE_NAME: texts[key] = item->name(); break;
+            }
+            loaded |= 1 << key;
+        }
+
+        return texts[key];
+    }
+
+    double number(ItemRuleKey key) {
+        if (key < RULE_TEXT_KEYS)
+            return wcstod(text(key).c_str(), nullptr);
+
+        if (!(loaded & (1 << key))) {
+            switch (key) {
+            case RULE_INDEX: numbers[key] = index; break;
+            case RULE_RARITY: numbers[key] = item->get_rarity(); break;
+            case RULE_ITEM_LEVEL: numbers[key] = item->get_item_level(); break;
+            case RULE_QUALITY: numbers[key] = item->get_quality(); break;
+            case RULE_SOCKETS: numbers[key] = item->get_sockets(); break;
+            case RULE_LINKS: numbers[key] = item->get_links(); break;
+            case RULE_TIER: numbers[key] = item->get_tier(); break;
+            case RULE_LEVEL: numbers[key] = item->get_level(); break;
+            case RULE_STACK_COUNT: numbers[key] = item->get_stack_count(); break;
+            case RULE_CHARGES: numbers[key] = item->get_charges(); break;
+            case RULE_WIDTH: numbers[key] = item->get_width(); break;
+            case RULE_HEIGHT: numbers[key] = item->get_height(); break;
+            case RULE_IS_IDENTIFIED: numbers[key] = item->is_identified(); break;
+            case RULE_IS_MIRRORED: numbers[key] = item->is_mirrored(); break;
+            case RULE_IS_CORRUPTED: numbers[key] = item->is_corrupted(); break;
+            case RULE_IS_RGB: numbers[key] = item->is_rgb(); break;
+            }
+            loaded |= 1 << key;
+        }
+
+        return numbers[key];
+    }
+
+    bool is_type(const wstring& type) {
+        return type == text(RULE_BASE_TYPE) || type == text(RULE_SUB_TYPE);
+    }
+
+    int stat_value(const wstring& id) {
+        return item->get_stat_value(id.c_str());
+    }
+};
+
+/* One constraint of a rule, a number, a range [min, max) or a regex. */
+struct ItemRuleConstraint {
+    ItemRuleKey key;
+    wstring type;           /* for is<Type> */
+    wstring stat;           /* for stat.<id> */
+    bool is_number = false;
+    bool is_range = false;
+    double min = 0, max = 0;
+    std::wregex regex;
+
+    double number(ItemRuleFields& fields) {
+        return (key == RULE_STAT) ? fields.stat_value(stat) : fields.number(key);
+    }
+
+    bool test(ItemRuleFields& fields) {
+        if (key == RULE_IS_TYPE)
+            return fields.is_type(type) == (min != 0);
+
+        if (is_range) {
+            double value = number(fields);
+            return value >= min && value < max;
+        }
+
+        if (is_number)
+            return number(fields) == min;
+
+        return std::regex_search(fields.text(key), regex);
+    }
+};
+
+struct ItemRule {
+    bool has_base_type = false;
+    bool has_base_name = false;
+    bool is_compiled = true;        /* false if the whole rule is left to the script */
+    bool is_deferred = false;       /* has constraints only the script can check */
+    std::wregex base_type, base_name;
+    std::vector<ItemRuleConstraint> constraints;
+};
+
+/* Compiled form of the Rules tables of PoETask.ahk (IdentifyExceptions, VendorRules,
+   StashRules...). A rule matches if its baseType or baseName regex matches and all
+   its constraints hold, the first matching rule wins.
+
+   The tables are serialized by the script, one rule per line of tab separated fields,
+   the baseType and baseName regexes then 'key=value' for a value constraint and
+   'key:min:max' for a range. A 'stat.<id>' key compares the value of a numeric
+   stat of the item's mods, e.g. 'stat.base_maximum_life:70:1000'. Backslash, tab,
+   newline, ':' and '=' in the keys and values are escaped with a backslash. */
+class ItemRules {
+protected:
+
+    std::vector<ItemRule> rules;
+
+    static bool parse_number(const wstring& s, double& value) {
+        wchar_t* end;
+
+        if (s.empty())
+            return false;
+        value = wcstod(s.c_str(), &end);
+        while (*end == L' ' || *end == L'\t')
+            ++end;
+        return *end == L'\0';
+    }
+
+    /* Returns the position of the first unescaped character of 'chars' in s. */
+    static int find_separator(const wstring& s, const wchar_t* chars, int pos = 0) {
+        for (int i = pos; i < s.size(); ++i) {
+            if (s[i] == L'\\')
+                ++i;
+            else if (wcschr(chars, s[i]))
+                return i;
+        }
+
+        return wstring::npos;
+    }
+
+    static wstring unescape(const wstring& s) {
+        wstring result;
+
+        result.reserve(s.size());
+        for (int i = 0; i < s.size(); ++i) {
+            wchar_t c = s[i];
+            if (c == L'\\' && i + 1 < s.size()) {
+                c = s[++i];
+                if (c == L't')
+                    c = L'\t';
+                else if (c == L'n')
+                    c = L'\n';
+                else if (c == L'r')
+                    c = L'\r';
+            }
+            result += c;
+        }
+
+        return result;
+    }
+
+    /* AutoHotkey regex options like "i)" are translated, the others are ignored. */
+    static void compile_regex(const wstring& pattern, std::wregex& regex) {
+        auto flags = std::regex::ECMAScript | std::regex::optimize;
+        int n = pattern.find(L')');
+
+        if (n != wstring::npos && pattern.find_first_not_of(L"imsxADJUXPSC`", 0) == n) {
+            if (pattern.substr(0, n).find(L'i') != wstring::npos)
+                flags |= std::regex::icase;
+            regex.assign(pattern.substr(n + 1), flags);
+        } else {
+            regex.assign(pattern, flags);
+        }
+    }
+
+    bool parse_constraint(const wstring& field, ItemRule& rule) {
+        int n = find_separator(field, L"=:");
+        if (n == wstring::npos || n == 0)
+            return false;
+
+        wstring key = unescape(field.substr(0, n));
+        wstring raw_value = field.substr(n + 1);
+        wstring value = unescape(raw_value);
+
+        ItemRuleConstraint c;
+        auto i = std::find_if(item_rule_keys.begin(), item_rule_keys.end(),
+                              [&](std::pair<const wchar_t*, ItemRuleKey>& k) {
+                                  return !_wcsicmp(k.first, key.c_str());
+                              });
+        if (key.size() > 5 && !_wcsnicmp(key.c_str(), L"stat.", 5)) {
+            c.key = RULE_STAT;
+            c.stat = key.substr(5);
+        } else if (i != item_rule_keys.end()) {
+            c.key = i->second;
+        } else if (key.size() > 2 && !_wcsnicmp(key.c_str(), L"is", 2)
+                   && field[n] == L'=' && parse_number(value, c.min))
+        {
+            c.key = RULE_IS_TYPE;
+            c.type = key.substr(2);
+        } else {
+            rule.is_deferred = true;
+            return true;
+        }
+
+        if (field[n] == L':') {
+            int m = find_separator(raw_value, L":");
+            if (m == wstring::npos || !parse_number(unescape(raw_value.substr(0, m)), c.min)
+                || !parse_number(unescape(raw_value.substr(m + 1)), c.max))
+                return false;
+            c.is_range = true;
+        } else if (parse_number(value, c.min)) {
+            c.is_number = true;
+        } else if (c.key == RULE_STAT) {
+            return false;
+        } else {
+            compile_regex(value, c.regex);
+        }
+        rule.constraints.push_back(std::move(c));
+
+        return true;
+    }
+
+    bool check(ItemRule& rule, ItemRuleFields& fields) {
+        if (!rule.is_compiled)
+            return true;
+
+        if (!(rule.has_base_type && std::regex_search(fields.text(RULE_BASE_TYPE), rule.base_type))
+            && !(rule.has_base_name && std::regex_search(fields.text(RULE_BASE_NAME), rule.base_name)))
+            return false;
+
+        for (auto& c : rule.constraints) {
+            if (!c.test(fields))
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+
+    std::vector<int> script_rules;      /* 1-based indices of the rules not compiled */
+
+    ItemRules(const wstring& serialized) {
+        for (int begin = 0, end; begin < serialized.size(); begin = end + 1) {
+            end = serialized.find(L'\n', begin);
+            if (end == wstring::npos)
+                end = serialized.size();
+
+            ItemRule rule;
+            try {
+                for (int i = begin, j, n = 0; i <= end; i = j + 1, ++n) {
+                    j = serialized.find(L'\t', i);
+                    if (j == wstring::npos || j > end)
+                        j = end;
+
+                    wstring field = serialized.substr(i, j - i);
+                    if (n < 2) {
+                        field = unescape(field);
+                        /* empty or "0" is false for the script */
+                        if (field.empty() || field == L"0")
+                            continue;
+                        compile_regex(field, (n == 0) ? rule.base_type : rule.base_name);
+                        ((n == 0) ? rule.has_base_type : rule.has_base_name) = true;
+                    } else if (!field.empty() && !parse_constraint(field, rule)) {
+                        rule.is_compiled = false;
+                    }
+                }
+            } catch (std::regex_error& e) {
+                /* PCRE of the script accepts more than std::regex */
+                rule.is_compiled = false;
+            }
+
+            if (!rule.is_compiled) {
+                rule.is_deferred = true;
+                script_rules.push_back(rules.size() + 1);
+            }
+            rules.push_back(std::move(rule));
+        }
+    }
+
+    int size() {
+        return rules.size();
+    }
+
+    /* Returns the 1-based index of the first rule matching the item at or after rule
+       'from', or 0. The index is negated if the rule has constraints that must still
+       be checked by the script, which goes on from the next rule if they fail. The
+       rules which could not be compiled are always returned negated. */
+    int check(Item& item, int index, int from = 1) {
+        ItemRuleFields fields(item, index);
+
+        for (int i = std::max(from, 1); i <= rules.size(); ++i) {
+            ItemRule& rule = rules[i - 1];
+            if (check(rule, fields))
+                return rule.is_deferred ? -i : i;
+        }
+
+        return 0;
+    }
+};
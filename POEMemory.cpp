@@ -4,6 +4,11 @@
 *  Path of Exile memory access interface.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
 template <typename T> T* read(HANDLE handle, addrtype address, T* buffer, int n) {
         if (ReadProcessMemory(handle, (LPVOID)address, buffer, n * sizeof(T), 0))
             return buffer;
@@ -83,16 +88,35 @@ template <> wstring read<wstring>(HANDLE handle, addrtype address) {
     return L"";
 }
 
+/* Default upper bound of the arrays read from the game, a larger size usually
+   means the vector was read while it was being modified. Callers expecting more
+   elements pass their own bound. Arrays are read by all the jobs, so the count
+   of truncated ones is atomic. */
+int max_array_size = 2048;
+std::atomic<int> truncated_arrays(0);
+
+int array_size(addrtype begin, addrtype end, int element_size, int max_size = max_array_size) {
+    if (end <= begin || element_size <= 0)
+        return 0;
+
+    unsigned __int64 n = (end - begin) / element_size;
+    if (n > max_size) {
+        truncated_arrays++;
+        n = max_size;
+    }
+
+    return n;
+}
+
 template <typename T> std::vector<T> read_array(HANDLE handle, addrtype address, int element_size) {
     addrtype begin = read<addrtype>(handle, address);
     addrtype end = read<addrtype>(handle, address + 0x8);
+    int n = array_size(begin, end, element_size);
 
     std::vector<T> vec;
-    for (address = begin; address < end; address += element_size) {
-        vec.push_back(T(address));
-        if (vec.size() > 2048)
-            break;
-    }
+    vec.reserve(n);
+    for (int i = 0; i < n; ++i)
+        vec.push_back(T(begin + i * element_size));
 
     return vec;
 }
@@ -100,41 +124,59 @@ template <typename T> std::vector<T> read_array(HANDLE handle, addrtype address,
 template <> std::vector<wstring> read_array(HANDLE handle, addrtype address, int element_size) {
     addrtype begin = read<addrtype>(handle, address);
     addrtype end = read<addrtype>(handle, address + 0x8);
+    int n = array_size(begin, end, element_size);
 
     std::vector<wstring> vec;
-    for (address = begin; address < end; address += element_size) {
-        vec.push_back(read<wstring>(handle, address));
-        if (vec.size() > 2048)
-            break;
-    }
+    vec.reserve(n);
+    for (int i = 0; i < n; ++i)
+        vec.push_back(read<wstring>(handle, begin + i * element_size));
 
     return vec;
 }
 
-template <typename T> std::vector<T> read_array(HANDLE handle, addrtype address, int offset, int element_size) {
+/* Reads the pointers at offset of each element, the whole array is read at once. */
+std::vector<addrtype> read_array_pointers(HANDLE handle, addrtype address, int offset, int element_size,
+                                          int max_size = max_array_size)
+{
     addrtype begin = read<addrtype>(handle, address);
     addrtype end = read<addrtype>(handle, address + 0x8);
+    int n = array_size(begin, end, element_size, max_size);
+    std::vector<addrtype> vec(n);
 
-    std::vector<T> vec;
-    for (address = begin; address < end; address += element_size) {
-        vec.push_back(T(read<addrtype>(handle, address + offset)));
-        if (vec.size() > 2048)
-            break;
+    if (n == 0 || offset + sizeof(addrtype) > element_size) {
+        for (int i = 0; i < n; ++i)
+            vec[i] = read<addrtype>(handle, begin + i * element_size + offset);
+        return vec;
+    }
+
+    /* an unreadable array leaves null pointers like the single reads did. */
+    std::vector<byte> buffer(n * element_size);
+    if (ReadProcessMemory(handle, (LPVOID)begin, buffer.data(), buffer.size(), 0)) {
+        for (int i = 0; i < n; ++i)
+            memcpy(&vec[i], &buffer[i * element_size + offset], sizeof(addrtype));
     }
 
     return vec;
 }
 
-template <> std::vector<wstring> read_array(HANDLE handle, addrtype address, int offset, int element_size) {
-    addrtype begin = read<addrtype>(handle, address);
-    addrtype end = read<addrtype>(handle, address + 0x8);
+template <typename T> std::vector<T> read_array(HANDLE handle, addrtype address, int offset, int element_size,
+                                                int max_size = max_array_size)
+{
+    std::vector<T> vec;
+
+    for (addrtype addr : read_array_pointers(handle, address, offset, element_size, max_size))
+        vec.push_back(T(addr));
+
+    return vec;
+}
 
+template <> std::vector<wstring> read_array(HANDLE handle, addrtype address, int offset, int element_size,
+                                             int max_size)
+{
     std::vector<wstring> vec;
-    for (address = begin; address < end; address += element_size) {
-        vec.push_back(read<wstring>(handle, read<addrtype>(handle, address + offset)));
-        if (vec.size() > 2048)
-            break;
-    }
+
+    for (addrtype addr : read_array_pointers(handle, address, offset, element_size, max_size))
+        vec.push_back(read<wstring>(handle, addr));
 
     return vec;
 }
@@ -152,6 +194,89 @@ template <typename T> bool write(HANDLE handle, addrtype address, T* buffer, int
     return false;
 }
 
+/* Collects small reads and issues them with as few ReadProcessMemory() calls as
+   possible, nearby requests are coalesced into one range and scattered back. */
+class ReadBatch {
+protected:
+
+    struct Request {
+        addrtype address;
+        void* buffer;
+        int size;
+        byte* status;       /* optional, set to 1 if the read succeeded, otherwise 0 */
+    };
+
+    std::vector<Request> requests;
+    std::vector<byte> buffer;
+
+public:
+
+    int max_gap = 64;
+    int max_size = 4096;
+
+    void add(addrtype address, void* dest, int size, byte* status = nullptr) {
+        requests.push_back({address, dest, size, status});
+    }
+
+    template <typename T> void add(addrtype address, T* dest, byte* status = nullptr) {
+        add(address, dest, sizeof(T), status);
+    }
+
+    int size() {
+        return requests.size();
+    }
+
+    void clear() {
+        requests.clear();
+    }
+
+    /* Returns the number of remote reads issued, failed reads zero their destinations. */
+    int run(HANDLE handle) {
+        int n = 0;
+
+        std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+            return a.address < b.address;
+        });
+
+        for (int i = 0, j; i < requests.size(); i = j) {
+            addrtype begin = requests[i].address;
+            addrtype end = begin + requests[i].size;
+
+            for (j = i + 1; j < requests.size(); ++j) {
+                Request& r = requests[j];
+                if (r.address > end + max_gap || r.address + r.size - begin > max_size)
+                    break;
+                end = std::max(end, r.address + r.size);
+            }
+
+            buffer.resize(end - begin);
+            n++;
+            if (ReadProcessMemory(handle, (LPVOID)begin, buffer.data(), end - begin, 0)) {
+                for (int k = i; k < j; ++k) {
+                    memcpy(requests[k].buffer, &buffer[requests[k].address - begin], requests[k].size);
+                    if (requests[k].status)
+                        *requests[k].status = 1;
+                }
+            } else {
+                /* the gap may cross an unreadable page, fall back to single reads. */
+                for (int k = i; k < j; ++k) {
+                    if (j - i > 1)
+                        n++;
+                    bool is_read = ReadProcessMemory(handle, (LPVOID)requests[k].address,
+                                                     requests[k].buffer, requests[k].size, 0);
+                    if (!is_read)
+                        memset(requests[k].buffer, 0, requests[k].size);
+                    if (requests[k].status)
+                        *requests[k].status = is_read;
+                }
+            }
+        }
+        requests.clear();
+
+        return n;
+    }
+};
+
 class PoEMemory {
 protected:
 
@@ -183,13 +308,19 @@ public:
         return ::read_array<T>(process_handle, address, element_size);
     }
 
-    template <typename T> std::vector<T> read_array(addrtype address, int offset, int element_size) {
-        return ::read_array<T>(process_handle, address, offset, element_size);
+    template <typename T> std::vector<T> read_array(addrtype address, int offset, int element_size,
+                                                    int max_size = max_array_size)
+    {
+        return ::read_array<T>(process_handle, address, offset, element_size, max_size);
     }
 
     template <typename T> bool write(addrtype address, T* buffer, int n) {
         return ::write(process_handle, address, buffer, n);
     }
+
+    int read(ReadBatch& batch) {
+        return batch.run(process_handle);
+    }
 };
 
 HANDLE PoEMemory::process_handle;
@@ -149,6 +149,7 @@ public:
     InGameData* in_game_data;
     ServerData* server_data;
     LocalPlayer *local_player;
+    EntitySet entities, labeled_entities;
     bool is_ready = false;
     unique_ptr<Canvas> hud;
 
@@ -225,6 +226,9 @@ public:
                 address = (addrtype)module_info.lpBaseOfDll;
                 size_of_image = module_info.SizeOfImage;
             }
+            mod_definitions.clear();
+            base_types.clear();
+            stat_table.clear();
             game_state_controller = get_game_state_controller();
             active_game_state = get_active_game_state();
 
@@ -48,6 +48,9 @@ public:
     virtual void on_entity_changed(EntityList& all, EntityList& removed, EntityList& added) {
     }
 
+    virtual void on_entity_events(EntityEvents& events) {
+    }
+
     virtual void on_labeled_entity_changed(EntityList& entities) {
     }
 
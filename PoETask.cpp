@@ -4,9 +4,11 @@
 
 #define DLLEXPORT extern "C" __declspec(dllexport)
 
-#include <mutex>
-
 #include "PoE.cpp"
+#include "EntityQuery.cpp"
+#include "AreaCache.cpp"
+#include "ItemFilter.cpp"
+#include "ItemRules.cpp"
 #include "PoEapi.c"
 #include "Task.cpp"
 #include "PoEPlugin.cpp"
@@ -33,24 +35,39 @@ static std::map<wstring, std::map<string, int>&> offsets = {
 
 class PoETask : public PoE, public Task {
 public:
-    
-    EntitySet entities;
-    EntityList labeled_entities, labeled_removed;
+
     int area_hash;
+    int entities_area_hash = 0;     /* area of the entities in the entity set */
+    DWORD area_loaded_time = 0;
+    AreaCache area_cache;
+    int last_truncated_arrays = 0;
+    bool entities_truncated = false;        /* the scan limits were hit by the last scan */
+    bool labels_truncated = false;
     wstring league;
 
     std::map<wstring, shared_ptr<PoEPlugin>> plugins;
-    std::wregex ignored_entity_exp;
-    std::mutex muxtex;
     bool is_attached = false;
+
+    /* held by the entity jobs for a whole tick, and both by reset() which tears down
+       the entity sets from the AutoHotkey thread. */
+    std::mutex entities_mutex, labeled_entities_mutex;
+
+    /* names and paths of the labeled entities, updated by LabeledEntityJob */
+    TextIndex labeled_names;
+    std::mutex labeled_names_mutex;
+    FlatSet<int> nearest_ids;
+    shared_ptr<Entity> nearest_entity;      /* kept alive for the script */
+
     bool is_active = false;
-    shared_ptr<Element> hovered_element;
-    shared_ptr<Item> hovered_item;
 
-    PoETask() : Task(L"PoETask"),
-        ignored_entity_exp(L"Doodad|WorldItem|Barrel|Basket|Bloom|BonePile|Boulder|Cairn|Crate|Pot|Urn|Vase"
-                           "|BlightFoundation|BlightTower|Effects")
-    {
+    /* compiled entity queries, used only by the AutoHotkey thread */
+    std::vector<shared_ptr<EntityQuery>> queries;
+    std::unordered_map<wstring, shared_ptr<EntityQuery>> type_queries;
+
+    /* compiled item rules of the script, as above */
+    std::vector<shared_ptr<ItemRules>> item_rules;
+
+    PoETask() : Task(L"PoETask") {
         /* add jobs */
         add_job(L"PlayerStatusJob", 99, [&] {this->check_player();});
         add_job(L"EntityJob", 55, [&] {this->check_entities();});
@@ -92,10 +109,18 @@ public:
         add_method(L"getPlugin", this, (MethodType)&PoETask::get_plugin, AhkObject, ParamList{AhkWString});
         add_method(L"getPlugins", this, (MethodType)&PoETask::get_plugins, AhkObject);
         add_method(L"getEntities", this, (MethodType)&PoETask::get_entities, AhkObject, ParamList{AhkWString});
+        add_method(L"compileQuery", this, (MethodType)&PoETask::compile_query, AhkInt, ParamList{AhkWString, AhkString, AhkInt, AhkInt, AhkInt});
+        add_method(L"releaseQuery", this, (MethodType)&PoETask::release_query, AhkVoid, ParamList{AhkInt});
+        add_method(L"queryEntities", this, (MethodType)&PoETask::query_entities, AhkObject, ParamList{AhkInt});
+        add_method(L"compileRules", this, (MethodType)&PoETask::compile_rules, AhkInt, ParamList{AhkWString});
+        add_method(L"checkItems", this, (MethodType)&PoETask::check_items, AhkObject, ParamList{AhkInt, AhkInt});
         add_method(L"getPlayer", this, (MethodType)&PoETask::get_player, AhkObject);
         add_method(L"getTerrain", this, (MethodType)&PoETask::get_terrain, AhkObject);
         add_method(L"getHoveredElement", this, (MethodType)&PoETask::get_hovered_element, AhkObject);
         add_method(L"getHoveredItem", this, (MethodType)&PoETask::get_hovered_item, AhkObject);
+        add_method(L"checkProjection", this, (MethodType)&PoETask::check_projection, AhkInt);
+        add_method(L"checkClassifier", this, (MethodType)&PoETask::check_entity_classifier, AhkInt);
+        add_method(L"benchmarkEntitySets", this, (MethodType)&PoETask::benchmark_entity_sets);
         add_method(L"setOffset", this, (MethodType)&PoETask::set_offset, AhkVoid, ParamList{AhkWString, AhkString, AhkInt});
         add_method(L"toggleMaphack", this, (MethodType)&PoETask::toggle_maphack, AhkBool);
         add_method(L"toggleHealthBar", this, (MethodType)&PoETask::toggle_health_bar, AhkBool);
@@ -129,14 +154,47 @@ public:
         return in_game_state->server_data()->latency();
     }
 
+    /* Served from the published labeled entities, the names are looked up in the
+       index kept by LabeledEntityJob. */
     AhkObjRef* get_nearest_entity(const wchar_t* text) {
-        if (is_in_game()) {
-            shared_ptr<Entity>& entity = in_game_ui->get_nearest_entity(*local_player, text);
-            if (entity)
-                return (AhkObjRef*)*entity;
+        if (!is_in_game())
+            return nullptr;
+
+        shared_ptr<const EntitySnapshot> snapshot = labeled_entities.acquire();
+        shared_ptr<const EntitySnapshot> player_snapshot = entities.acquire();
+        if (!snapshot)
+            return nullptr;
+
+        Point pos;
+        if (player_snapshot && player_snapshot->player)
+            pos = player_snapshot->player_pos;
+        else if (local_player && local_player->positioned)
+            pos = local_player->grid_position();
+        else
+            return nullptr;
+
+        nearest_ids.clear();
+        {
+            std::lock_guard<std::mutex> lock(labeled_names_mutex);
+            labeled_names.find(text, [&](int id) {nearest_ids.insert(id);});
         }
 
-        return nullptr;
+        __int64 min_dist = LLONG_MAX;
+        nearest_entity = nullptr;
+        for (int i = 0; i < snapshot->entities.size(); ++i) {
+            const shared_ptr<Entity>& e = snapshot->entities[i];
+            if (!e->positioned || !nearest_ids.count(e->id))
+                continue;
+
+            Point p = snapshot->states[i].pos;
+            __int64 dx = p.x - pos.x, dy = p.y - pos.y;
+            if (dx * dx + dy * dy < min_dist) {
+                min_dist = dx * dx + dy * dy;
+                nearest_entity = e;
+            }
+        }
+
+        return nearest_entity ? (AhkObjRef*)*nearest_entity : nullptr;
     }
 
     AhkObjRef* get_ingame_ui() {
@@ -307,17 +365,93 @@ public:
     }
 
     AhkObjRef* get_entities(const wchar_t* types) {
-        AhkTempObj temp_entities;
-        std::wregex types_exp(types);
-        for (auto& i : entities.all) {
-            if (std::regex_search(i.second->path, types_exp))
-                temp_entities.__set(L"", (AhkObjRef*)*i.second, AhkObject, nullptr);
+        shared_ptr<EntityQuery>& query = type_queries[types];
+        if (!query) {
+            if (type_queries.size() > 256) {
+                type_queries.clear();
+                return get_entities(types);
+            }
+            query = shared_ptr<EntityQuery>(new EntityQuery(types));
+        }
+
+        return get_query_result(*query);
+    }
+
+    /* Returns a handle of the compiled query, state is one of EntityQueryState.
+       The handles of the released queries are reused. */
+    int compile_query(const wchar_t* types, const char* components, int min_rarity, int state, int max_distance) {
+        shared_ptr<EntityQuery> query(new EntityQuery(types, components, min_rarity, state, max_distance));
+
+        for (int i = 0; i < queries.size(); ++i) {
+            if (!queries[i]) {
+                queries[i] = query;
+                return i + 1;
+            }
+        }
+        queries.push_back(query);
+
+        return queries.size();
+    }
+
+    void release_query(int handle) {
+        if (handle > 0 && handle <= queries.size())
+            queries[handle - 1].reset();
+    }
+
+    AhkObjRef* query_entities(int handle) {
+        if (handle <= 0 || handle > queries.size() || !queries[handle - 1])
+            return nullptr;
+        return get_query_result(*queries[handle - 1]);
+    }
+
+    int compile_rules(const wchar_t* serialized) {
+        shared_ptr<ItemRules> rules(new ItemRules(serialized));
+        for (int i : rules->script_rules)
+            log(L"compileRules: rule #%d cannot be compiled, it is checked by the script", i);
+
+        item_rules.push_back(rules);
+        return item_rules.size();
+    }
+
+    /* Returns the index of the first matching rule of every item in the inventory
+       slot, keyed by the item index, the items without a matching rule are left out. */
+    AhkObjRef* check_items(int handle, int inventory_id) {
+        if (handle <= 0 || handle > item_rules.size() || !is_in_game())
+            return nullptr;
+
+        auto& slots = server_data->get_inventory_slots();
+        auto i = slots.find(inventory_id);
+        if (i == slots.end())
+            return nullptr;
+
+        AhkTempObj results;
+        ItemRules& rules = *item_rules[handle - 1];
+        for (auto& cell : i->second->get_cells()) {
+            shared_ptr<Item> item = cell.second->get_item();
+            if (!item)
+                continue;
+
+            int rule = rules.check(*item, cell.first);
+            if (rule)
+                results.__set(std::to_wstring(cell.first).c_str(), rule, AhkInt, nullptr);
         }
 
+        return results;
+    }
+
+    AhkObjRef* get_query_result(EntityQuery& query) {
+        AhkTempObj temp_entities;
+        shared_ptr<const EntitySnapshot> snapshot = entities.acquire();
+        for (auto& i : query.run(snapshot))
+            temp_entities.__set(L"", (AhkObjRef*)*i, AhkObject, nullptr);
+
         return temp_entities;
     }
 
     AhkObjRef* get_player() {
+        shared_ptr<const EntitySnapshot> snapshot = entities.acquire();
+        if (snapshot && snapshot->player)
+            return (AhkObjRef*)*snapshot->player;
         if (local_player)
             return (AhkObjRef*)*local_player;
         return nullptr;
@@ -330,23 +464,39 @@ public:
     }
 
     AhkObjRef* get_hovered_element() {
-        Element* e = in_game_state->get_hovered_element();
-        if (e) {
-            hovered_element = shared_ptr<Element>(e);
-            return *hovered_element;
-        }
-
-        return nullptr;
+        shared_ptr<Element> e = in_game_state->get_hovered_element();
+        return e ? (AhkObjRef*)*e : nullptr;
     }
 
     AhkObjRef* get_hovered_item() {
-        Item* item = in_game_state->get_hovered_item();
-        if (item) {
-            hovered_item = shared_ptr<Item>(item);
-            return *hovered_item;
-        }
+        shared_ptr<Item> item = in_game_state->get_hovered_item();
+        return item ? (AhkObjRef*)*item : nullptr;
+    }
 
-        return nullptr;
+    /* Returns the number of positions project_batch() projects differently from
+       project(). */
+    int check_projection() {
+        int mismatches = check_project_batch();
+
+        log(L"project_batch: %d mismatches with the scalar projection.", mismatches);
+        return mismatches;
+    }
+
+    /* Returns the number of entity paths the classifier got wrong, and logs its
+       speed against a regex. */
+    int check_entity_classifier() {
+        float matcher_time, regex_time;
+        int mismatches = check_classifier(matcher_time, regex_time);
+
+        log(L"classifier: %d mismatches, %.3f us per path (regex %.3f us).",
+            mismatches, matcher_time, regex_time);
+        return mismatches;
+    }
+
+    /* Logs the time taken by the entity scan's node set with synthetic entity counts. */
+    void benchmark_entity_sets() {
+        for (int n : {1000, 5000, 20000})
+            log(L"%d entities: %.1f us per scan.", n, benchmark_flat_set(n));
     }
 
     void set_offset(wchar_t* catalog, char* key, int value) {
@@ -356,7 +506,9 @@ public:
     }
 
     void reset() {
-        std::unique_lock<std::mutex> lock;
+        std::lock(entities_mutex, labeled_entities_mutex);
+        std::lock_guard<std::mutex> entities_lock(entities_mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> labeled_entities_lock(labeled_entities_mutex, std::adopt_lock);
 
         if (is_ready || !PoE::is_in_game())
             return;
@@ -365,9 +517,17 @@ public:
         for (auto& i : plugins)
             i.second->reset();
 
-        // clear cached entities.
-        entities.all.clear();
+        // keep the metadata of the area for re-entry, then clear cached entities.
+        area_cache.save(entities_area_hash, entities, in_game_data);
+        entities_area_hash = 0;
+        entities.clear();
         labeled_entities.clear();
+        {
+            std::lock_guard<std::mutex> lock(labeled_names_mutex);
+            labeled_names.clear();
+        }
+        entity_classifier.clear();
+        entity_archetypes.clear();
 
         if (in_game_state) {
             in_game_state->reset();
@@ -474,6 +634,8 @@ public:
 
         if (in_game_data->area_hash() != area_hash) {
             area_hash = in_game_data->area_hash();
+            area_loaded_time = GetTickCount();
+
             AreaTemplate* world_area = in_game_data->world_area();
             if (!world_area->name().empty()) {
                 for (auto i : plugins)
@@ -487,28 +649,74 @@ public:
     }
 
     void check_entities() {
+        std::lock_guard<std::mutex> lock(entities_mutex);
+
         if (GetForegroundWindow() != hwnd || !is_ready || !is_in_game())
             return;
 
-        in_game_data->get_all_entities(entities, ignored_entity_exp);
+        /* the entity types are released with the area, unless they are still valid
+           in an area visited before. They are restored by this thread, between two
+           scans, because the scan uses the restored ignored ids and positions. */
+        int hash = in_game_data->area_hash();
+        if (hash != entities_area_hash) {
+            entities.decoder.parallel_count = 0;
+            entity_archetypes.clear();
+            entity_classifier.clear();
+            if (area_cache.restore(hash, in_game_data))
+                log(L"restored %d entity types of the area.", area_cache.restored);
+            entities_area_hash = hash;
+        }
+
+        int count = in_game_data->get_all_entities(entities);
+        in_game_ui->max_labels = std::max(2048, count);
+        int arrays = truncated_arrays;
+        if ((in_game_data->truncated && !entities_truncated) || arrays != last_truncated_arrays)
+            log(L"Entity scan truncated: %d nodes of %d entities, %d arrays over %d elements.",
+                in_game_data->max_nodes, count, arrays, max_array_size);
+        entities_truncated = in_game_data->truncated;
+        last_truncated_arrays = arrays;
+        entities.publish(in_game_data->player);
         for (auto& i : plugins) {
             if (entities.all.size() > 128)
                 SwitchToThread();
-            if (is_ready && i.second->enabled && i.second->player)
+            if (is_ready && i.second->enabled && i.second->player) {
+                i.second->on_entity_events(entities.table.events);
                 i.second->on_entity_changed(entities.all, entities.removed, entities.added);
+            }
+        }
+
+        if (area_loaded_time && in_game_data->pending_count() == 0) {
+            log(L"First complete entity tick %dms after loading, %d entities (%d decoded in parallel).",
+                GetTickCount() - area_loaded_time, entities.all.size(), entities.decoder.parallel_count);
+            area_loaded_time = 0;
         }
     }
 
     void check_labeled_entities() {
+        std::lock_guard<std::mutex> lock(labeled_entities_mutex);
+
         if (GetForegroundWindow() != hwnd || !is_ready || !is_in_game())
             return;
 
-        in_game_ui->get_all_entities(labeled_entities, labeled_removed);
+        in_game_ui->get_all_entities(labeled_entities);
+        {
+            std::lock_guard<std::mutex> lock(labeled_names_mutex);
+            for (auto& i : labeled_entities.removed)
+                labeled_names.remove(i.first);
+            for (auto& i : labeled_entities.added)
+                labeled_names.insert(i.first, i.second->name() + L"\n" + i.second->path);
+        }
+        if (in_game_ui->labels_truncated != labels_truncated) {
+            labels_truncated = in_game_ui->labels_truncated;
+            if (labels_truncated)
+                log(L"Labeled entity scan truncated at %d labels.", in_game_ui->max_labels);
+        }
+        labeled_entities.publish();
         for (auto& i : plugins) {
-            if (labeled_entities.size() > 128)
+            if (labeled_entities.all.size() > 128)
                 SwitchToThread();
             if (is_ready && i.second->enabled && i.second->player)
-                i.second->on_labeled_entity_changed(labeled_entities);
+                i.second->on_labeled_entity_changed(labeled_entities.all);
         }
     }
 
@@ -527,6 +735,7 @@ public:
     void stop() {
         is_ready = false;
         Task::stop();
+        entities.decoder.stop();
         Sleep(300);
         hud.reset();
     }
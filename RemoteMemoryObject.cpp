@@ -83,9 +83,11 @@ public:
         return std::vector<T>();
     }
 
-    template<typename T> std::vector<T> read_array(const string& field_name, int offset, int element_size) {
+    template<typename T> std::vector<T> read_array(const string& field_name, int offset, int element_size,
+                                                   int max_size = max_array_size)
+    {
         if (offsets->find(field_name) != offsets->end())
-            return PoEMemory::read_array<T>(address + (*offsets)[field_name], offset, element_size);
+            return PoEMemory::read_array<T>(address + (*offsets)[field_name], offset, element_size, max_size);
         return std::vector<T>();
     }
 
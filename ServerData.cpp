@@ -3,6 +3,7 @@
 */
 
 #include <algorithm>
+#include <regex>
 #include <unordered_map>
 
 static std::map<string, int> inventory_cell_offsets {
@@ -22,15 +23,21 @@ public:
     InventoryCell(addrtype address)
         : RemoteMemoryObject(address, &inventory_cell_offsets)
     {
+        read_geometry();
+    }
+
+    void read_geometry() {
         x = read<int>("l");
         y = read<int>("t");
         w = read<int>("r") - x;
         h = read<int>("b") - y;
     }
 
+    /* The item is decoded again when it was replaced, or identified or crafted on
+       in place, which also drops its cached full name. */
     shared_ptr<Item> get_item() {
         addrtype addr = read<addrtype>("item");
-        if (!item || item->address != addr)
+        if (!item || item->address != addr || item->is_changed())
             item = shared_ptr<Item>(new Item(addr));
 
         return item;
@@ -92,6 +99,54 @@ private:
         return items;
     }
 
+    wstring find_pattern;
+    std::wregex find_regex;
+
+    /* Finds the items whose full names match the regex, case insensitive, ordered by
+       index. Only the matched items are returned, with their indices and cells. An
+       invalid regex matches nothing, its error is left in the findError property. */
+    AhkObjRef* find_items(const wchar_t* pattern, int max_rarity = 3, int limit = 0) {
+        AhkTempObj results;
+
+        if (find_pattern != pattern) {
+            try {
+                find_regex.assign(pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+                __set(L"findError", "", AhkString, nullptr);
+            } catch (std::regex_error& e) {
+                find_regex.assign(L"(?!)");
+                __set(L"findError", e.what(), AhkString, nullptr);
+            }
+            find_pattern = pattern;
+        }
+
+        std::vector<int> indices;
+        for (auto& i : get_cells())
+            indices.push_back(i.first);
+        std::sort(indices.begin(), indices.end());
+
+        int n = 0;
+        for (int index : indices) {
+            shared_ptr<InventoryCell>& cell = cells[index];
+            shared_ptr<Item> item = cell->get_item();
+            if (item->get_rarity() > max_rarity || !std::regex_search(item->get_full_name(), find_regex))
+                continue;
+
+            AhkObj found;
+            found.__set(L"index", index, AhkInt,
+                        L"left", cell->x + 1, AhkInt,
+                        L"top", cell->y + 1, AhkInt,
+                        L"width", cell->w, AhkInt,
+                        L"height", cell->h, AhkInt,
+                        L"stackCount", item->get_stack_count(), AhkInt,
+                        nullptr);
+            results.__set(L"", (AhkObjRef*)found, AhkObject, nullptr);
+            if (++n == limit)
+                break;
+        }
+
+        return results;
+    }
+
 public:
 
     std::unordered_map<int, shared_ptr<InventoryCell>> cells;
@@ -112,6 +167,7 @@ public:
         add_method(L"getLayout", this, (MethodType)&InventorySlot::get_layout, AhkObject);
         add_method(L"getItemByIndex", this, (MethodType)&InventorySlot::__get_item_by_index, AhkObject, ParamList{AhkInt});
         add_method(L"getItems", this, (MethodType)&InventorySlot::__get_items, AhkObject);
+        add_method(L"findItems", this, (MethodType)&InventorySlot::find_items, AhkObject, ParamList{AhkWString, AhkInt, AhkInt});
     }
 
     void __new() {
@@ -130,7 +186,7 @@ public:
 
     int free_cells() {
         int free_cells = 0;
-        for (auto addr : read_array<addrtype>("cells", 0x0, 8)) {
+        for (auto addr : read_array<addrtype>("cells", 0x0, 8, cols * rows)) {
             if (addr == 0)
                 free_cells++;
         }
@@ -145,7 +201,7 @@ public:
         removed_cells.swap(cells);
 
         int n = 0, l = 0;
-        for (auto addr : read_array<addrtype>("cells", 0x0, 8)) {
+        for (auto addr : read_array<addrtype>("cells", 0x0, 8, cols * rows)) {
             l <<= 1;
             l |= addr ? 1 : 0;
             if (++n == cols) {
@@ -160,7 +216,7 @@ public:
     }
 
     int next_cell(int width = 1, int height = 1) {
-        auto all_cells = read_array<addrtype>("cells", 0x0, 8);
+        auto all_cells = read_array<addrtype>("cells", 0x0, 8, cols * rows);
         for (int l = 0; l < cols; ++l)
             for (int t = 0; t < rows; ++t) {
                 if (all_cells[t * cols + l] == 0) {
@@ -187,7 +243,7 @@ public:
         removed_cells.swap(cells);
 
         if (count() > 0) {
-            for (auto addr : read_array<addrtype>("cells", 0x0, 8)) {
+            for (auto addr : read_array<addrtype>("cells", 0x0, 8, cols * rows)) {
                 if (addr > 0) {
                     shared_ptr<InventoryCell> cell(new InventoryCell(addr));
                     int index = cell->x * rows + cell->y + 1;
@@ -214,6 +270,13 @@ public:
         int n = ((index  - 1) % rows) * cols + (index  - 1) / rows;
         addrtype addr = PoEMemory::read<addrtype>(read<addrtype>("cells") + n * 8);
         if (addr > 0) {
+            /* the cell keeps its item, but the item may have been moved. */
+            auto i = cells.find(index);
+            if (i != cells.end() && i->second->address == addr) {
+                i->second->read_geometry();
+                return i->second;
+            }
+
             shared_ptr<InventoryCell> cell(new InventoryCell(addr));
             cells[index] = cell;
             return cell;
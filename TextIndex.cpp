@@ -0,0 +1,156 @@
+/*
+* TextIndex.cpp, 10/19/2026 10:15 PM
+*/
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+/* Trigram index over the texts of entities, used to find the entities whose text
+   contains a string without scanning all of them. Equal texts are interned and
+   shared by all the entities using them. */
+class TextIndex {
+protected:
+
+    struct Document {
+        wstring text;
+        std::vector<int> ids;
+    };
+
+    std::unordered_map<wstring, int> documents_by_text;
+    std::vector<Document> documents;
+    std::vector<int> free_documents;
+    std::unordered_map<unsigned __int64, std::vector<int>> postings;
+    std::unordered_map<int, int> entity_documents;
+    std::vector<unsigned __int64> keys;
+
+    static unsigned __int64 trigram(const wchar_t* s) {
+        return ((unsigned __int64)(s[0] & 0x1fffff) << 42)
+               | ((unsigned __int64)(s[1] & 0x1fffff) << 21)
+               | (s[2] & 0x1fffff);
+    }
+
+    /* unique trigrams of text in keys */
+    void get_trigrams(const wstring& text) {
+        keys.clear();
+        for (int i = 0; i + 3 <= text.size(); ++i)
+            keys.push_back(trigram(&text[i]));
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    }
+
+    int add_document(const wstring& text) {
+        auto i = documents_by_text.find(text);
+        if (i != documents_by_text.end())
+            return i->second;
+
+        int doc;
+        if (!free_documents.empty()) {
+            doc = free_documents.back();
+            free_documents.pop_back();
+        } else {
+            doc = documents.size();
+            documents.push_back(Document());
+        }
+        documents[doc].text = text;
+        documents_by_text[text] = doc;
+
+        get_trigrams(text);
+        for (auto k : keys)
+            postings[k].push_back(doc);
+
+        return doc;
+    }
+
+    void remove_document(int doc) {
+        get_trigrams(documents[doc].text);
+        for (auto k : keys) {
+            auto i = postings.find(k);
+            if (i == postings.end())
+                continue;
+
+            std::vector<int>& v = i->second;
+            auto j = std::find(v.begin(), v.end(), doc);
+            if (j != v.end()) {
+                *j = v.back();
+                v.pop_back();
+            }
+            if (v.empty())
+                postings.erase(i);
+        }
+
+        documents_by_text.erase(documents[doc].text);
+        documents[doc].text.clear();
+        free_documents.push_back(doc);
+    }
+
+public:
+
+    int size() {
+        return entity_documents.size();
+    }
+
+    void clear() {
+        documents_by_text.clear();
+        documents.clear();
+        free_documents.clear();
+        postings.clear();
+        entity_documents.clear();
+    }
+
+    void insert(int id, const wstring& text) {
+        remove(id);
+
+        int doc = add_document(text);
+        documents[doc].ids.push_back(id);
+        entity_documents[id] = doc;
+    }
+
+    void remove(int id) {
+        auto i = entity_documents.find(id);
+        if (i == entity_documents.end())
+            return;
+
+        int doc = i->second;
+        std::vector<int>& ids = documents[doc].ids;
+        auto j = std::find(ids.begin(), ids.end(), id);
+        if (j != ids.end()) {
+            *j = ids.back();
+            ids.pop_back();
+        }
+        if (ids.empty())
+            remove_document(doc);
+        entity_documents.erase(i);
+    }
+
+    /* Calls func with the id of every entity whose text contains s. */
+    template <typename F> void find(const wstring& s, F func) {
+        if (s.size() < 3) {
+            for (auto& doc : documents) {
+                if (!doc.ids.empty() && doc.text.find(s) != wstring::npos) {
+                    for (int id : doc.ids)
+                        func(id);
+                }
+            }
+            return;
+        }
+
+        /* verify the documents of the rarest trigram of s. */
+        std::vector<int>* candidates = nullptr;
+        get_trigrams(s);
+        for (auto k : keys) {
+            auto i = postings.find(k);
+            if (i == postings.end())
+                return;
+            if (!candidates || i->second.size() < candidates->size())
+                candidates = &i->second;
+        }
+
+        for (int doc : *candidates) {
+            if (documents[doc].text.find(s) != wstring::npos) {
+                for (int id : documents[doc].ids)
+                    func(id);
+            }
+        }
+    }
+};
@@ -2,6 +2,9 @@
 * Base.cpp, 8/11/2020 11:01 AM
 */
 
+#include <mutex>
+#include <unordered_map>
+
 /* Base component offsets */
 
 static std::map<string, int> base_component_offsets {
@@ -13,19 +16,105 @@ static std::map<string, int> base_component_offsets {
     {"is_corrupted",   0xd7},
 };
 
+/* Decoded base item type, shared by all the items of the type. */
+struct BaseType {
+    addrtype internal;
+    wstring name;
+    int width, height;
+};
+
+/* Base item types and captured monster names by the address of their records,
+   the records are static game data, so the table is only cleared with the process. */
+class BaseTypeTable : public PoEMemory {
+protected:
+
+    std::unordered_map<addrtype, shared_ptr<const BaseType>> types;
+    std::unordered_map<addrtype, wstring> monster_names;
+    std::mutex mutex;
+
+public:
+
+    shared_ptr<const BaseType> get(addrtype internal) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto i = types.find(internal);
+            if (i != types.end())
+                return i->second;
+        }
+
+        BaseType* type = new BaseType();
+        byte cells[2] = {}, is_read[2] = {};
+        type->internal = internal;
+        type->name = PoEMemory::read<wstring>(internal + base_component_offsets["name"]);
+
+        /* the cell counts are adjacent, the batch reads them in one call. */
+        ReadBatch batch;
+        batch.add(internal + base_component_offsets["x_cells"], &cells[0], &is_read[0]);
+        batch.add(internal + base_component_offsets["y_cells"], &cells[1], &is_read[1]);
+        PoEMemory::read(batch);
+        type->width = cells[0];
+        type->height = cells[1];
+
+        /* a type which couldn't be read is returned but not cached, so it is read
+           again by the next item. */
+        if (!is_read[0] || !is_read[1] || type->name.empty())
+            return shared_ptr<const BaseType>(type);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return types.insert(std::make_pair(internal, shared_ptr<const BaseType>(type))).first->second;
+    }
+
+    wstring get_monster_name(addrtype internal, int offset) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto i = monster_names.find(internal);
+            if (i != monster_names.end())
+                return i->second;
+        }
+
+        wstring name = PoEMemory::read<wstring>(internal + offset, 32);
+        if (name.empty())
+            return name;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return monster_names.insert(std::make_pair(internal, name)).first->second;
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return types.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        types.clear();
+        monster_names.clear();
+    }
+};
+
+/* Global base type table */
+BaseTypeTable base_types;
+
 class Base : public Component {
 protected:
 
     wstring base_name;
+    shared_ptr<const BaseType> type;
 
 public:
 
     Base(addrtype address) : Component(address, "Base", &base_component_offsets) {
     }
 
+    const BaseType& get_type() {
+        if (!type)
+            type = base_types.get(read<addrtype>("internal"));
+        return *type;
+    }
+
     wstring& name() {
         if (base_name.empty())
-            base_name = read<wstring>("internal", "name");
+            base_name = get_type().name;
         return base_name;
     }
 
@@ -38,18 +127,15 @@ public:
     }
 
     int width() {
-        return read<byte>("internal", "x_cells");
+        return get_type().width;
     }
 
     int height() {
-        return read<byte>("internal", "y_cells");
+        return get_type().height;
     }
 
     int size() {
-        int w = read<byte>("internal", "x_cells");
-        int h = read<byte>("internal", "y_cells");
-
-        return w * h;
+        return get_type().width * get_type().height;
     }
 
     void to_print() {
@@ -20,7 +20,7 @@ public:
     wstring& name() {
         if (beast_name.empty()) {
             addrtype internal = read<addrtype>("internal");
-            beast_name = PoEMemory::read<wstring>(internal + (*offsets)["name"], 32);
+            beast_name = base_types.get_monster_name(internal, (*offsets)["name"]);
         }
 
         return beast_name;
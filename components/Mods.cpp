@@ -2,6 +2,10 @@
 * Mods.cpp, 8/10/2020 11:38 PM
 */
 
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
 static std::map<string, int> modifier_offsets {
     {"id",         0x0},
     {"type",      0x14},
@@ -14,17 +18,183 @@ static std::map<string, int> modifier_offsets {
     {"stat_vals", 0x78},
 };
 
+/* Stats interned to small integers by the address of their rows in the stat table,
+   the id strings are only read when they are displayed or looked up by name. */
+class StatTable : public PoEMemory {
+protected:
+
+    std::unordered_map<addrtype, int> indices;
+    std::vector<addrtype> rows;
+    std::vector<wstring> names;
+    std::unordered_map<wstring, int> indices_by_name;
+    std::mutex mutex;
+
+    const wstring& get_name(int stat) {
+        if (names[stat].empty()) {
+            names[stat] = PoEMemory::read<wstring>(rows[stat], 128);
+            indices_by_name[names[stat]] = stat;
+        }
+        return names[stat];
+    }
+
+public:
+
+    int intern(addrtype row) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = indices.find(row);
+        if (i != indices.end())
+            return i->second;
+
+        rows.push_back(row);
+        names.push_back(L"");
+        indices[row] = rows.size() - 1;
+
+        return rows.size() - 1;
+    }
+
+    wstring name(int stat) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (stat >= 0 && stat < rows.size()) ? get_name(stat) : L"";
+    }
+
+    /* Returns the stat with the given id, or -1 if no item carried it yet. */
+    int find(const wstring& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto i = indices_by_name.find(id);
+        if (i != indices_by_name.end())
+            return i->second;
+
+        for (int stat = 0; stat < rows.size(); ++stat) {
+            if (names[stat].empty() && get_name(stat) == id)
+                return stat;
+        }
+
+        return -1;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        indices.clear();
+        rows.clear();
+        names.clear();
+        indices_by_name.clear();
+    }
+};
+
+/* Global stat table */
+StatTable stat_table;
+
+/* Decoded static definition of a mod, shared by all the items carrying the mod. */
+struct ModDefinition {
+    addrtype address;
+    wstring id, name, group;
+    int domain, gen_type;
+    int req_level;
+    std::vector<int> stats;     /* interned stats, the mod's values are in the same order */
+};
+
+/* Mod definitions by address. The definitions are game data which never change
+   while the game is running, so the cache is only cleared with the process. */
+class ModDefinitionCache : public PoEMemory {
+protected:
+
+    std::unordered_map<addrtype, shared_ptr<const ModDefinition>> definitions;
+    std::mutex mutex;
+
+    wstring read_string(addrtype address, int max_len) {
+        wchar_t buffer[max_len + 1];
+
+        if (!address || !PoEMemory::read<wchar_t>(address, buffer, max_len))
+            return L"";
+        buffer[max_len] = L'\0';
+
+        return buffer;
+    }
+
+    template <typename T> T field(byte* record, const string& name, int offset = 0) {
+        T t;
+        memcpy(&t, &record[modifier_offsets[name] + offset], sizeof(T));
+        return t;
+    }
+
+    /* the record is read in one call, then the strings it points to. Returns
+       false if the record couldn't be read, the definition is then empty. */
+    bool decode(addrtype address, ModDefinition* def) {
+        byte record[0x78];
+
+        def->address = address;
+        if (!PoEMemory::read<byte>(address, record, sizeof(record)))
+            return false;
+
+        def->id = read_string(field<addrtype>(record, "id"), 128);
+        def->name = read_string(field<addrtype>(record, "name"), 32);
+        def->group = read_string(field<addrtype>(record, "group"), 128);
+        def->domain = field<int>(record, "domain");
+        def->gen_type = field<int>(record, "gen_type");
+        def->req_level = field<byte>(record, "req_level");
+
+        /* up to four stat references of 0x10 bytes, the row pointer comes first. */
+        for (int i = 0; i < 4; ++i) {
+            addrtype row = field<addrtype>(record, "stats", i * 0x10);
+            if (!row)
+                break;
+            def->stats.push_back(stat_table.intern(row));
+        }
+
+        return true;
+    }
+
+public:
+
+    shared_ptr<const ModDefinition> get(addrtype address) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto i = definitions.find(address);
+            if (i != definitions.end())
+                return i->second;
+        }
+
+        /* a definition which couldn't be read is not cached, so it is read again
+           by the next item carrying the mod. */
+        ModDefinition* def = new ModDefinition();
+        if (!decode(address, def))
+            return shared_ptr<const ModDefinition>(def);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        return definitions.insert(std::make_pair(address, shared_ptr<const ModDefinition>(def))).first->second;
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return definitions.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        definitions.clear();
+    }
+};
+
+/* Global mod definition cache */
+ModDefinitionCache mod_definitions;
+
 class Modifier : RemoteMemoryObject {
 public:
 
+    shared_ptr<const ModDefinition> definition;
     wstring id, name;
     int domain, gen_type;
+    std::vector<int> values;    /* rolled values of the item's mod */
 
-    Modifier(addrtype address) : RemoteMemoryObject(address, &modifier_offsets) {
-        id = PoEMemory::read<wstring>(address, 128);
-        name = PoEMemory::read<wstring>(address + (*offsets)["name"], 32);
-        domain = read<int>("domain");
-        gen_type = read<int>("gen_type");
+    Modifier(addrtype address) : RemoteMemoryObject(address, &modifier_offsets),
+        definition(mod_definitions.get(address))
+    {
+        id = definition->id;
+        name = definition->name;
+        domain = definition->domain;
+        gen_type = definition->gen_type;
     }
 
     wstring type() {
@@ -32,11 +202,11 @@ public:
     }
 
     int req_level() {
-        return read<byte>("req_level");
+        return definition->req_level;
     }
 
     wstring group() {
-        return PoEMemory::read<wstring>(address  + (*offsets)["group"], 128);
+        return definition->group;
     }
 
     void to_print() {
@@ -64,7 +234,97 @@ static std::map<string, int> mods_component_offsets {
     {"is_synthesised",  0x4a1},
 };
 
+enum ItemStatSource {
+    STAT_IMPLICIT,
+    STAT_ENCHANT,
+    STAT_EXPLICIT,
+};
+
+/* Numeric stat of an item, the name of the stat is in the stat table. */
+struct ItemStat {
+    int stat;
+    short source;
+    int value;
+};
+
+/* Vectors of the Mods component, in the order of Mods::vectors. */
+enum ModsVector {
+    MODS_IMPLICIT_MODS,
+    MODS_ENCHANT_MODS,
+    MODS_EXPLICIT_MODS,
+    MODS_IMPLICIT_STATS,
+    MODS_ENCHANT_STATS,
+    MODS_EXPLICIT_STATS,
+    MODS_CRAFTED_STATS,
+    MODS_FRACTURED_STATS,
+    MODS_VECTORS,
+};
+
+static const char* mods_vector_names[] = {
+    "implicit_mods", "enchant_mods", "explicit_mods",
+    "implicit_stats", "enchant_stats", "explicit_stats", "crafted_stats", "fractured_stats",
+};
+
 class Mods : public Component {
+protected:
+
+    /* the component is read whole once by the constructor, which keeps only the
+       fields below. The vectors it refers to are read later in batches. */
+    static const int block_size = 0x4a2;
+    static const int max_content_size = 0x80;
+    byte content[max_content_size];
+    int content_length = 0;
+    addrtype vectors[MODS_VECTORS][2];      /* begin and end of each vector */
+    bool identified, mirrored, synthesised;
+    bool mods_loaded = false;
+    bool stats_loaded = false;
+    bool numeric_stats_loaded = false;
+
+    template <typename T> T field(const byte* block, const string& name, int offset = 0) {
+        T t = {};
+        int i = (*offsets)[name] + offset;
+
+        if (i >= 0 && i + sizeof(T) <= block_size)
+            memcpy(&t, &block[i], sizeof(T));
+        return t;
+    }
+
+    /* number of elements of the vector */
+    int vector_size(int vector, int element_size) {
+        return array_size(vectors[vector][0], vectors[vector][1], element_size);
+    }
+
+    /* The identified flag, the rarity and the mod vectors, the part of the block
+       which changes when the item is identified or crafted on in place. */
+    static int content_offset() {
+        return mods_component_offsets["is_identified"];
+    }
+
+    static int content_size() {
+        return mods_component_offsets["enchant_mods"] + 0x18 - content_offset();
+    }
+
+    static unsigned __int64 hash_content(const byte* content, int size) {
+        unsigned __int64 hash = 14695981039346656037ull;
+
+        for (int i = 0; i < size; ++i)
+            hash = (hash ^ content[i]) * 1099511628211ull;
+
+        return hash;
+    }
+
+    /* reads the bodies of n vectors from the first one in one batch. */
+    void read_vectors(int first, std::vector<byte>* bodies, int n, int element_size) {
+        ReadBatch batch;
+
+        for (int i = 0; i < n; ++i) {
+            bodies[i].resize(vector_size(first + i, element_size) * element_size);
+            if (!bodies[i].empty())
+                batch.add(vectors[first + i][0], bodies[i].data(), bodies[i].size());
+        }
+        PoEMemory::read(batch);
+    }
+
 public:
 
     wstring unique_name;
@@ -82,9 +342,53 @@ public:
     std::vector<wstring> crafted_stats;
     std::vector<wstring> fractured_stats;
 
+    /* Numeric stats, decoded from the mods */
+    std::vector<ItemStat> numeric_stats;
+
     Mods(addrtype address) : Component(address, "Mods", &mods_component_offsets) {
-        rarity = read<int>("rarity");
-        item_level = read<int>("item_level");
+        std::vector<byte> block(block_size);
+
+        if (!PoEMemory::read<byte>(address, block.data(), block_size))
+            std::fill(block.begin(), block.end(), 0);
+
+        rarity = field<int>(block.data(), "rarity");
+        item_level = field<int>(block.data(), "item_level");
+        identified = field<byte>(block.data(), "is_identified");
+        mirrored = field<byte>(block.data(), "is_mirrored");
+        synthesised = field<byte>(block.data(), "is_synthesised");
+        for (int i = 0; i < MODS_VECTORS; ++i) {
+            vectors[i][0] = field<addrtype>(block.data(), mods_vector_names[i]);
+            vectors[i][1] = field<addrtype>(block.data(), mods_vector_names[i], 0x8);
+        }
+
+        int offset = content_offset(), size = content_size();
+        if (offset >= 0 && size > 0 && size <= max_content_size && offset + size <= block_size) {
+            memcpy(content, &block[offset], size);
+            content_length = size;
+        }
+    }
+
+    /* Returns the content word of the Mods component at the given address,
+       0 if it can't be read. */
+    static unsigned __int64 read_content_word(addrtype address) {
+        byte content[max_content_size];
+        int size = content_size();
+
+        if (size <= 0 || size > sizeof(content)
+            || !::read<byte>(process_handle, address + content_offset(), content, size))
+            return 0;
+
+        return hash_content(content, size);
+    }
+
+    /* Content word of the block read by the constructor. */
+    unsigned __int64 content_word() {
+        return content_length ? hash_content(content, content_length) : 0;
+    }
+
+    /* Returns true if the item was identified or modified since it was read. */
+    bool is_changed() {
+        return read_content_word(address) != content_word();
     }
 
     wstring& name(wstring& base_name) {
@@ -113,35 +417,121 @@ public:
     }
 
     bool is_identified() {
-        return read<byte>("is_identified");
+        return identified;
     }
 
     bool is_synthesised() {
-        return read<byte>("is_synthesised");
+        return synthesised;
     }
 
     bool is_mirrored() {
-        return read<byte>("is_mirrored");
+        return mirrored;
     }
 
     void get_mods() {
-        if (!explicit_mods.empty())
+        std::vector<Modifier>* lists[] = {&implicit_mods, &enchant_mods, &explicit_mods};
+        std::vector<byte> bodies[3];
+
+        if (mods_loaded)
             return;
+        mods_loaded = true;
+
+        /* the values vector is at 0x0 and the definition pointer is at 0x18
+           of each 0x28 bytes mod entry, the values are read in one batch. The
+           batch keeps pointers into the modifiers, so the lists are sized first
+           and never reallocated before the read. */
+        ReadBatch batch;
+        read_vectors(MODS_IMPLICIT_MODS, bodies, 3, 0x28);
+        for (int i = 0; i < 3; ++i) {
+            lists[i]->clear();
+            lists[i]->reserve(bodies[i].size() / 0x28);
+            for (int j = 0; j + 0x28 <= bodies[i].size(); j += 0x28) {
+                addrtype entry[4];
+                memcpy(entry, &bodies[i][j], sizeof(entry));
+                lists[i]->push_back(Modifier(entry[3]));
+
+                std::vector<int>& values = lists[i]->back().values;
+                values.resize(array_size(entry[0], entry[1], sizeof(int)));
+                if (!values.empty())
+                    batch.add(entry[0], values.data(), values.size() * sizeof(int));
+            }
+        }
+        PoEMemory::read(batch);
+    }
+
+    std::vector<ItemStat>& get_numeric_stats() {
+        std::vector<Modifier>* lists[] = {&implicit_mods, &enchant_mods, &explicit_mods};
+        short sources[] = {STAT_IMPLICIT, STAT_ENCHANT, STAT_EXPLICIT};
+
+        if (numeric_stats_loaded)
+            return numeric_stats;
+        numeric_stats_loaded = true;
+
+        get_mods();
+        for (int i = 0; i < 3; ++i) {
+            for (auto& m : *lists[i]) {
+                const std::vector<int>& stats = m.definition->stats;
+                for (int k = 0; k < stats.size() && k < m.values.size(); ++k)
+                    numeric_stats.push_back({stats[k], sources[i], m.values[k]});
+            }
+        }
+
+        return numeric_stats;
+    }
 
-        implicit_mods = read_array<Modifier>("implicit_mods", 0x18, 0x28);
-        enchant_mods = read_array<Modifier>("enchant_mods", 0x18, 0x28);
-        explicit_mods = read_array<Modifier>("explicit_mods", 0x18, 0x28);
+    /* Sum of the values of the stat over all the mods, 0 if the item has no such stat. */
+    int stat_value(int stat) {
+        int value = 0;
+
+        for (auto& i : get_numeric_stats()) {
+            if (i.stat == stat)
+                value += i.value;
+        }
+
+        return value;
     }
 
     void get_stats() {
-        if (!explicit_stats.empty())
+        std::vector<wstring>* lists[] = {&implicit_stats, &enchant_stats, &explicit_stats,
+                                         &crafted_stats, &fractured_stats};
+        std::vector<byte> bodies[5];
+        std::vector<std::vector<wchar_t>> buffers;
+        ReadBatch batch;
+
+        if (stats_loaded)
             return;
+        stats_loaded = true;
 
-        implicit_stats = read_array<wstring>("implicit_stats", 0x20);
-        enchant_stats = read_array<wstring>("enchant_stats", 0x20);
-        explicit_stats = read_array<wstring>("explicit_stats", 0x20);
-        crafted_stats = read_array<wstring>("crafted_stats", 0x20);
-        fractured_stats = read_array<wstring>("fractured_stats", 0x20);
+        /* the stats are std::wstrings of 0x20 bytes, short ones are stored inline. */
+        read_vectors(MODS_IMPLICIT_STATS, bodies, 5, 0x20);
+        for (int i = 0; i < 5; ++i) {
+            for (int j = 0; j + 0x20 <= bodies[i].size(); j += 0x20) {
+                unsigned int len, max_len;
+                addrtype addr;
+
+                memcpy(&addr, &bodies[i][j], sizeof(addrtype));
+                memcpy(&len, &bodies[i][j + 0x10], sizeof(int));
+                memcpy(&max_len, &bodies[i][j + 0x18], sizeof(int));
+
+                buffers.push_back(std::vector<wchar_t>());
+                if (len > max_len || len >= 512 || max_len >= 1024)
+                    continue;
+
+                std::vector<wchar_t>& buffer = buffers.back();
+                buffer.resize(len);
+                if (max_len < 8)
+                    memcpy(buffer.data(), &bodies[i][j], len * sizeof(wchar_t));
+                else if (len > 0)
+                    batch.add(addr, buffer.data(), len * sizeof(wchar_t));
+            }
+        }
+        PoEMemory::read(batch);
+
+        for (int i = 0, k = 0; i < 5; ++i) {
+            lists[i]->clear();
+            for (int j = 0; j + 0x20 <= bodies[i].size(); j += 0x20, ++k)
+                lists[i]->push_back(wstring(buffers[k].data(), buffers[k].size()));
+        }
     }
 
     void to_print() {
@@ -9,73 +9,122 @@ static std::map<string, int> sockets_component_offsets {
     {"links",   0x60},
 };
 
+/* Layout of the packed socket word, colours are 1-6 (R, G, B, W, A, D) and 0 for
+   no socket. Bit i of the link bits is set if socket i is linked to socket i + 1. */
+enum SocketBits : unsigned __int64 {
+    SOCKET_COLOR_SHIFT  = 0,        /* 6 x 3 bits */
+    SOCKET_LINK_SHIFT   = 18,       /* 5 bits */
+    SOCKET_COUNT_SHIFT  = 24,       /* 3 bits */
+    SOCKET_MAX_LINK_SHIFT = 28,     /* 3 bits */
+    SOCKET_COLOR_COUNT_SHIFT = 32,  /* 6 x 3 bits, the count of colour c at 32 + (c - 1) * 3 */
+
+    SOCKET_RGB          = 1ull << 56,   /* a linked group has red, green and blue sockets */
+    SOCKET_6S           = 1ull << 57,
+    SOCKET_6L           = 1ull << 58,
+    SOCKET_DECODED      = 1ull << 63,
+};
+
 class Sockets : public Component {
 protected:
 
-    int number_of_sockets;
-    int number_of_links;
-    bool linked_rgb;
-    int socket_types[6];
+    unsigned __int64 packed = 0;
+
+    /* The socket types and the link vector are read at once, then the link sizes. */
+    void decode() {
+        int sockets_offset = (*offsets)["sockets"];
+        int links_offset = (*offsets)["links"];
+        int block_size = links_offset + 0x10 - sockets_offset;
+        byte data[0x100];
+        byte groups[6];
+        int socket_types[6], colors[6];
+        addrtype begin, end;
+
+        packed = SOCKET_DECODED;
+        if (block_size < sizeof(socket_types) + 0x10 || block_size > sizeof(data)
+            || !PoEMemory::read<byte>(address + sockets_offset, data, block_size))
+            return;
+
+        memcpy(socket_types, data, sizeof(socket_types));
+        memcpy(&begin, data + links_offset - sockets_offset, sizeof(addrtype));
+        memcpy(&end, data + links_offset - sockets_offset + 0x8, sizeof(addrtype));
+
+        int n = 0;
+        for (int t : socket_types) {
+            if (t > 0 && t <= 6) {
+                packed |= (unsigned __int64)t << (SOCKET_COLOR_SHIFT + n * 3);
+                packed += 1ull << (SOCKET_COLOR_COUNT_SHIFT + (t - 1) * 3);
+                colors[n++] = t;
+            }
+        }
+        packed |= (unsigned __int64)n << SOCKET_COUNT_SHIFT;
+        if (n == 6)
+            packed |= SOCKET_6S;
+
+        int size = end - begin;
+        if (size <= 0 || size > 6 || !PoEMemory::read<byte>(begin, groups, size))
+            return;
+
+        int max_link = 0;
+        for (int i = 0, k = 0; i < size && k < n; ++i) {
+            int l = std::min<int>(groups[i], n - k);
+            int group_colors = 0;
+
+            max_link = std::max(max_link, l);
+            for (int j = 0; j < l; ++j) {
+                group_colors |= 1 << colors[k + j];
+                if (j > 0)
+                    packed |= 1ull << (SOCKET_LINK_SHIFT + k + j - 1);
+            }
+            if ((group_colors & 0xe) == 0xe)
+                packed |= SOCKET_RGB;
+            k += l;
+        }
+        packed |= (unsigned __int64)max_link << SOCKET_MAX_LINK_SHIFT;
+        if (max_link == 6)
+            packed |= SOCKET_6L;
+    }
 
 public:
 
     Sockets(addrtype address) : Component(address, "Sockets", &sockets_component_offsets) {
-        number_of_sockets = number_of_links = 0;
-        linked_rgb = false;
     }
 
-    int sockets() {
-        if (number_of_sockets == 0) {
-            PoEMemory::read(address + (*offsets)["sockets"], (byte*)socket_types, 24);
-            for (int t : socket_types) {
-                if (t > 0 && t <= 6)
-                    number_of_sockets += 1;
-            }
-        }
+    /* Returns the packed socket word, decoded once per item. */
+    unsigned __int64 get_packed() {
+        if (!packed)
+            decode();
+        return packed;
+    }
 
-        return number_of_sockets;
+    int color(int i) {
+        return (get_packed() >> (SOCKET_COLOR_SHIFT + i * 3)) & 0x7;
     }
 
-    int links() {
-        if (number_of_sockets == 0)
-            sockets();
-        
-        if (number_of_links == 0) {
-            int rgb = 0, i = 0;
-
-            for (auto l : read_array<byte>("links", 0x0, 1)) {
-                if (l > number_of_links)
-                    number_of_links = l;
-
-                if (l >= 3) {
-                    for (int k = 0; k < l; ++k)
-                        rgb |= (1 << socket_types[i + k]) & 0xf;
-                }
-
-                i += l;
-            }
-            linked_rgb = !(rgb ^ 0xe);
-        }
+    int color_count(int c) {
+        return (get_packed() >> (SOCKET_COLOR_COUNT_SHIFT + (c - 1) * 3)) & 0x7;
+    }
 
-        return number_of_links;
+    int sockets() {
+        return (get_packed() >> SOCKET_COUNT_SHIFT) & 0x7;
+    }
+
+    int links() {
+        return (get_packed() >> SOCKET_MAX_LINK_SHIFT) & 0x7;
     }
 
     bool is_rgb() {
-        links();
-        return linked_rgb;
+        return get_packed() & SOCKET_RGB;
     }
 
     void to_print() {
         const char* socket_colors[] = {"", "R", "G", "B", "W", "A", "D"};
-        int i = 0;
+        unsigned __int64 word = get_packed();
 
         Component::to_print();
-        sockets();
         printf("\t\t\t! ");
-        for (auto l : read_array<byte>("links", 0x0, 1)) {
-            for (int k = 0; k < l; k++)
-                printf("%s%s", k > 0 ? "-" : "", socket_colors[socket_types[i++]]);
-            printf(" ");
+        for (int i = 0; i < sockets(); ++i) {
+            bool linked = i > 0 && (word & (1ull << (SOCKET_LINK_SHIFT + i - 1)));
+            printf("%s%s", (i == 0) ? "" : (linked ? "-" : " "), socket_colors[color(i)]);
         }
     }
 };
@@ -86,67 +86,69 @@ public:
     }
 
     void on_entity_changed(EntityList& entities, EntityList& removed, EntityList& add) {
-        for (auto& i : entities) {
+        EntityTable& table = poe->entities.table;
+        Point center = player->grid_position();
+
+        for (Entity* entity : poe->entities.grid.query_radius(center, 4 * range)) {
             if (force_reset) {
                 force_reset = false;
                 return;
             }
 
-            if (ignored_entities.find(i.second->id) != ignored_entities.end())
+            if (ignored_entities.find(entity->id) != ignored_entities.end())
                 continue;
 
-            int dist = player->dist(*i.second);
+            int dist = EntityGrid::distance(center, entity->pos);
             if (dist > 4 * range)
                 continue;
 
-            Targetable* targetable = i.second->get_component<Targetable>();
-            if (!targetable || !targetable->is_targetable())
+            if (!table.targetable[entity->slot])
                 continue;
 
-            int index = i.second->has_component(entity_types);
+            int index = entity->has_component(entity_types);
             switch (index) {
             case 0: { // Chest
                 if (dist <= range && chest_enabled) {
-                    if (std::regex_search(i.second->name(), ignored_chests))
+                    if (std::regex_search(entity->name(), ignored_chests))
                         break;
 
                     if (delve_chest_only) {
-                        if ((i.second->path.find(L"DelveChest") == wstring::npos))
+                        if (!(entity->category & CATEGORY_DELVE_CHEST_NAME))
                             break;
-                    } else if (i.second->path.find(L"HeistChest") != wstring::npos) {
+                    } else if (entity->category & CATEGORY_HEIST_CHEST_NAME) {
                         break;
                     }
 
-                    Chest* chest = i.second->get_component<Chest>();
-                    if (!chest->is_opened() && !chest->is_locked())
-                        try_open(i.second.get());
+                    Chest* chest = entity->get_component<Chest>();
+                    if (!table.chest_opened[entity->slot] && !chest->is_locked())
+                        try_open(entity);
                 }
                 break;
             }
 
             case 1: { // MinimapIcon
-                MinimapIcon* minimap_icon = i.second->get_component<MinimapIcon>();
+                MinimapIcon* minimap_icon = entity->get_component<MinimapIcon>();
                 if (dist <= 2 * range && std::regex_search(minimap_icon->name(), entity_names))
-                    try_open(i.second.get());
+                    try_open(entity);
                 break;
             }
 
             case 2: { // TriggerableBlockage
                 if (door_enabled) {
-                    TriggerableBlockage* blockage = i.second->get_component<TriggerableBlockage>();
-                    if (blockage->is_closed() && i.second->path.find(L"Labyrinth/Objects") == string::npos)
-                        try_open(i.second.get());
+                    TriggerableBlockage* blockage = entity->get_component<TriggerableBlockage>();
+                    if (blockage->is_closed() && !(entity->category & CATEGORY_LABYRINTH_OBJECT))
+                        try_open(entity);
                 }
                 break;
             }
 
             case 3: // Transitionable
-                if (dist <= 2 * range && std::regex_search(i.second->name(), entity_names))
-                    try_open(i.second.get());
+                if (dist <= 2 * range && std::regex_search(entity->name(), entity_names))
+                    try_open(entity);
                 break;
 
             default:
-                ignored_entities.insert(i.second->id);
+                ignored_entities.insert(entity->id);
             }
         };
     }
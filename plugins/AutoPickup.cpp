@@ -2,6 +2,18 @@
 * AutoPickup.cpp, 9/18/2020 11:11 PM
 */
 
+#include <mutex>
+#include <unordered_map>
+
+/* Verdict of check_item() for an item, valid while the item's hash and the content
+   word of its Mods component are unchanged. */
+struct ItemVerdict {
+    unsigned __int64 hash;
+    addrtype mods;
+    unsigned __int64 content;
+    bool is_pickable;
+};
+
 class AutoPickup : public PoEPlugin {
 public:
 
@@ -32,6 +44,18 @@ public:
     std::wregex generic_item_filter;
     std::wregex rare_item_filter;
 
+    /* verdicts by item address, cleared on area change or when the filters change.
+       The filters are set by the script's thread, so they and the verdicts are
+       guarded by filter_mutex. */
+    std::unordered_map<addrtype, ItemVerdict> item_verdicts;
+    std::mutex filter_mutex;
+    int verdict_strict_level = 0;
+    int max_verdicts = 4096;
+
+    /* game item filter, replaces the strict level policy when loaded */
+    ItemFilter item_filter;
+    ItemFields item_fields;
+
     AutoPickup() : PoEPlugin(L"AutoPickup", "0.11") {
         add_property(L"range", &range, AhkInt);
         add_property(L"ignoreChests", &ignore_chests, AhkBool);
@@ -44,6 +68,9 @@ public:
         add_method(L"stopPickup", this, (MethodType)&AutoPickup::stop_pickup);
         add_method(L"getDroppedItems", this, (MethodType)&AutoPickup::get_dropped_items, AhkObject);
         add_method(L"getItem", this, (MethodType)&AutoPickup::get_item, AhkObject, ParamList{AhkInt});
+        add_method(L"loadFilter", this, (MethodType)&AutoPickup::load_filter, AhkInt, ParamList{AhkWString});
+        add_method(L"unloadFilter", this, (MethodType)&AutoPickup::unload_filter);
+        add_method(L"benchmarkFilter", this, (MethodType)&AutoPickup::benchmark_filter, AhkFloat, ParamList{AhkInt});
 
         set_generic_item_filter(L"Incubator|Scarab$|Quicksilver|Diamond|Basalt|Quartz");
         set_rare_item_filter(L"Jewels|Amulet|Rings|Belts");
@@ -54,14 +81,62 @@ public:
         ignored_entities.clear();
         selected_item.reset();
         dropped_items.clear();
+
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        item_verdicts.clear();
+    }
+
+    void on_area_changed(AreaTemplate* world_area, int hash_code, LocalPlayer* player) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        item_verdicts.clear();
     }
 
     void set_generic_item_filter(const wchar_t* regex_string) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
         generic_item_filter.assign(regex_string);
+        item_verdicts.clear();
     }
 
     void set_rare_item_filter(const wchar_t* regex_string) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
         rare_item_filter.assign(regex_string);
+        item_verdicts.clear();
+    }
+
+    /* Returns the number of rules loaded, 0 if the filter couldn't be loaded. */
+    int load_filter(const wchar_t* file_name) {
+        ItemFilter filter;
+        bool is_loaded = filter.load(file_name);
+
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        item_verdicts.clear();
+        if (!is_loaded) {
+            log(L"failed to load item filter '%s'", file_name);
+            item_filter.clear();
+            return 0;
+        }
+
+        item_filter = std::move(filter);
+        log(L"loaded %d rules from '%s', %d conditions not supported and ignored.",
+            item_filter.size(), file_name, item_filter.unsupported);
+        for (auto& i : item_filter.unsupported_keywords)
+            log(L"    '%s' conditions are ignored.", i.c_str());
+        return item_filter.size();
+    }
+
+    void unload_filter() {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        item_filter.clear();
+        item_verdicts.clear();
+    }
+
+    /* Returns the microseconds taken by the loaded filter to evaluate a screen of n items. */
+    float benchmark_filter(int n) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+        float elapsed = item_filter.benchmark(n);
+
+        log(L"%d rules evaluated against %d items in %.2f us.", item_filter.size(), n, elapsed);
+        return elapsed;
     }
 
     void begin_pickup() {
@@ -84,13 +159,56 @@ public:
         is_picking = false;
     }
 
+    /* Hash of the item's type and component list, the list is replaced when the
+       item is modified. */
+    unsigned __int64 get_item_hash(addrtype address) {
+        addrtype header[3] = {};     /* internal, component list begin and end */
+        unsigned __int64 hash = 14695981039346656037ull;
+
+        poe->read<addrtype>(address + 0x8, header, 3);
+        for (auto i : header)
+            hash = (hash ^ i) * 1099511628211ull;
+
+        return hash;
+    }
+
     bool check_item(addrtype address) {
+        std::lock_guard<std::mutex> lock(filter_mutex);
+
+        if (verdict_strict_level != strict_level) {
+            verdict_strict_level = strict_level;
+            item_verdicts.clear();
+        }
+
+        unsigned __int64 hash = get_item_hash(address);
+        auto i = item_verdicts.find(address);
+        if (i != item_verdicts.end() && i->second.hash == hash
+            && (!i->second.mods || Mods::read_content_word(i->second.mods) == i->second.content))
+            return i->second.is_pickable;
+
+        if (item_verdicts.size() >= max_verdicts)
+            item_verdicts.clear();
+
         Item item(address);
+        Mods* mods = item.get_component<Mods>();
+        bool is_pickable = evaluate_item(item);
+        item_verdicts[address] = {hash, mods ? mods->address : 0,
+                                  mods ? mods->content_word() : 0, is_pickable};
+
+        return is_pickable;
+    }
+
+    bool evaluate_item(Item& item) {
+        if (item_filter.size() > 0) {
+            get_item_fields(item, item_fields);
+            return item_filter.is_shown(item_fields);
+        }
 
         if (item.has_component(item_types) >= 0)
             return true;
 
-        if (item.get_links() == 6)
+        unsigned __int64 sockets = item.get_socket_info();
+        if (sockets & SOCKET_6L)
             return true;
 
         if (strict_level < 3) {
@@ -103,7 +221,7 @@ public:
                         return true;
 
                 case 1:
-                    if (rarity == 3 || item.get_sockets() == 6 || item.is_rgb())
+                    if (rarity == 3 || (sockets & (SOCKET_6S | SOCKET_RGB)))
                         return true;
                     if (item.has_component("SkillGem"))
                         return (item.get_quality() >= 5);
@@ -141,6 +259,45 @@ public:
         return nullptr;
     }
 
+    bool is_pickable(Entity* entity) {
+        int index = entity->has_component(entity_types);
+        if (index < 0)
+            return false;
+
+        if (ignored_entities.find(entity->id) != ignored_entities.end())
+            return false;
+
+        switch (index) {
+        case 0:
+            {
+                if (ignore_chests || (entity->category & CATEGORY_IZARO_CHEST))
+                    return false;
+
+                Chest* chest = entity->get_component<Chest>();
+                if (!chest || chest->is_locked())
+                    return false;
+            }
+            break;
+
+        case 1:
+            {
+                WorldItem* world_item = entity->get_component<WorldItem>();
+                if (!world_item || !check_item(world_item->item()))
+                    return false;
+
+                if (event_enabled && dropped_items.find(entity->id) == dropped_items.end()) {
+                    Item* item = new Item(world_item->item());
+                    dropped_items[entity->id] = shared_ptr<Item>(item);
+                    PostThreadMessage(thread_id, WM_NEW_ITEM, (WPARAM)item->name().c_str(),
+                                      (LPARAM)entity->id);
+                }
+            }
+            break;
+        }
+
+        return true;
+    }
+
     void on_labeled_entity_changed(EntityList& entities) {
         shared_ptr<Entity> nearest_item;
         if (!is_picking && !event_enabled)
@@ -156,53 +313,31 @@ public:
         if (selected_item && entities.find(selected_item->id) != entities.end())
             return;
 
-        int min_dist = range;
-        for (auto& i : entities) {
-            if (force_reset) {
-                force_reset = false;
-                return;
-            }
-
-            int index = i.second->has_component(entity_types);
-            if (index < 0)
-                continue;
-
-            if (ignored_entities.find(i.second->id) != ignored_entities.end())
-                continue;
+        Point center = player->grid_position();
+        if (event_enabled) {
+            /* every labeled item has to be checked for the new item events. */
+            int min_dist = range;
+            for (auto& i : entities) {
+                if (force_reset) {
+                    force_reset = false;
+                    return;
+                }
 
-            switch (index) {
-            case 0:
-                {
-                    if (ignore_chests || i.second->path.find(L"IzaroChest") != wstring::npos)
-                        continue;
+                if (!is_pickable(i.second.get()))
+                    continue;
 
-                    Chest* chest = i.second->get_component<Chest>();
-                    if (!chest || chest->is_locked())
-                        continue;
-                }
-                break;
-
-            case 1:
-                {
-                    WorldItem* world_item = i.second->get_component<WorldItem>();
-                    if (!world_item || !check_item(world_item->item()))
-                        continue;
-
-                    if (event_enabled && dropped_items.find(i.second->id) == dropped_items.end()) {
-                        Item* item = new Item(world_item->item());
-                        dropped_items[i.second->id] = shared_ptr<Item>(item);
-                        PostThreadMessage(thread_id, WM_NEW_ITEM, (WPARAM)item->name().c_str(),
-                                          (LPARAM)i.second->id);
-                    }
+                int dist = i.second->positioned ? EntityGrid::distance(center, i.second->pos) : -1;
+                if (dist < min_dist) {
+                    nearest_item = i.second;
+                    min_dist = dist;
                 }
-                break;
-            }
-
-            int dist = player->dist(*i.second);
-            if (dist < min_dist) {
-                nearest_item = i.second;
-                min_dist = dist;
             }
+        } else if (range > 0) {
+            Entity* entity = poe->labeled_entities.grid.nearest(center, range - 1, [&](Entity* e) {
+                return is_pickable(e);
+            });
+            if (entity)
+                nearest_item = entities[entity->id];
         }
 
         if (!is_picking || !nearest_item)
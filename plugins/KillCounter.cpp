@@ -153,87 +153,106 @@ public:
         PostThreadMessage(thread_id, WM_KILL_COUNTER, kills, total_monsters);
     }
 
-    void on_entity_changed(EntityList& entities, EntityList& removed, EntityList& added) {
-        int n_monsters = 0, charges = 0, n_minions = 0;
+    void on_entity_events(EntityEvents& events) {
         if (!current_area)
             return;
 
-        if (entities.size() == added.size())
-            nearby_monsters.clear();
-
-        for (auto& i : removed) {
-            shared_ptr<Entity>& entity = i.second;
-            if (entity->is_monster) {
-                if (current_area->killed.find(i.first) == current_area->killed.end()
-                    && nearby_monsters.find(i.first) != nearby_monsters.end())
-                {
-                    current_area->killed.insert(i.first);
-                    current_area->kills[entity->rarity]++;
+        EntityTable& table = poe->entities.table;
+        for (auto& i : events) {
+            if (force_reset) {
+                force_reset = false;
+                return;
+            }
+
+            Entity* entity = i.entity;
+            if (!entity->is_monster || entity->is_neutral)
+                continue;
+
+            switch (i.type) {
+            case ENTITY_SPAWNED: {
+                int life = table.life[entity->slot];
+                if (life == 1)  // Some special monsters only have 1 life until activated.
+                    break;
+
+                if (life == 0) {
+                    if (current_area->total.find(i.id) != current_area->total.end())
+                        add_kill(i.id, entity->rarity);
+                    break;
                 }
+
+                add_monster(i.id, entity);
+                break;
+            }
+
+            case ENTITY_LIFE_GAINED:
+                add_monster(i.id, entity);
+                break;
+
+            case ENTITY_DIED:
+                if (current_area->total.find(i.id) != current_area->total.end())
+                    add_kill(i.id, entity->rarity);
+                break;
+
+            case ENTITY_DESPAWNED:
+                if (nearby_monsters.find(i.id) != nearby_monsters.end())
+                    add_kill(i.id, entity->rarity);
+                break;
             }
         }
+    }
+
+    void add_monster(int id, Entity* entity) {
+        if (entity->category & CATEGORY_AFFLICTION_VOLATILE)
+            return;
 
+        if (current_area->total.find(id) == current_area->total.end()) {
+            if (event_enabled && entity->rarity > 1)    // rare and unique monsters
+                PostThreadMessage(thread_id, WM_NEW_MONSTER, (WPARAM)entity->name().c_str(),
+                                  (LPARAM)entity->id);
+            current_area->total.insert(id);
+        }
+    }
+
+    void add_kill(int id, int rarity) {
+        if (current_area->killed.find(id) == current_area->killed.end()) {
+            current_area->killed.insert(id);
+            current_area->kills[rarity]++;
+        }
+    }
+
+    void on_entity_changed(EntityList& entities, EntityList& removed, EntityList& added) {
+        int n_monsters = 0, charges = 0, n_minions = 0;
+        if (!current_area)
+            return;
+
+        EntityTable& table = poe->entities.table;
         nearby_monsters.clear();
-        for (auto& i : entities) {
-            if (force_reset) {
-                force_reset = false;
-                return;
+        Point center = player->grid_position();
+        for (Entity* entity : poe->entities.grid.query_radius(center, 2 * nearby_radius)) {
+            if (!entity->is_monster)
+                continue;
+
+            if (!entity->is_neutral) {
+                int life = table.life[entity->slot];
+                if (life == 1 || life == 0 || (entity->category & CATEGORY_AFFLICTION_VOLATILE))
+                    continue;
             }
 
-            Entity* entity = i.second.get();
-            if (entity->is_monster) {
-                if (!entity->is_neutral) {
-#if 0
-                    if (entity->has_component("DiesAfterTime"))
-                        continue;
-#endif
-                    int life = entity->life();
-                    if (life == 1)  // Some special monsters only have 1 life.
-                        continue;
-
-                    if (life == 0) {
-                        if (current_area->total.find(i.first) != current_area->total.end()
-                            && current_area->killed.find(i.first) == current_area->killed.end())
-                        {
-                            current_area->killed.insert(i.first);
-                            current_area->kills[entity->rarity]++;
-                        }
-                        continue;
-                    }
-
-                    if (entity->path.find(L"AfflictionVolatile") != wstring::npos)
-                        continue;
-
-                    if (current_area->total.find(i.first) == current_area->total.end()) {
-                        if (event_enabled && entity->rarity > 1) {     // rare and unique monsters
-                            Render* render = entity->get_component<Render>();
-                            if (render) {
-                                Vector3 pos = render->position();
-                                poe->in_game_state->transform(pos);
-                                PostThreadMessage(thread_id, WM_NEW_MONSTER, (WPARAM)entity->name().c_str(),
-                                                  (LPARAM)entity->id);
-                            }
-                        }
-                        current_area->total.insert(i.first);
-                    }
-                }
+            int dist = EntityGrid::distance(center, entity->pos);
+            if (!entity->is_neutral && dist < 2 * nearby_radius)
+                nearby_monsters.insert(entity->id);
 
-                int dist = player->dist(*entity);
-                if (!entity->is_neutral && dist < 2 * nearby_radius)
-                    nearby_monsters.insert(i.first);
-
-                if (dist < nearby_radius) {
-                    if (entity->is_neutral) {
-                        n_minions++;
-                        continue;
-                    }
-
-                    n_monsters++;
-                    if (entity->rarity > 0)
-                        charges += 1 + (1 << (entity->rarity - 1)) * 2.5;
-                    else
-                        charges += 1;
+            if (dist < nearby_radius) {
+                if (entity->is_neutral) {
+                    n_minions++;
+                    continue;
                 }
+
+                n_monsters++;
+                if (entity->rarity > 0)
+                    charges += 1 + (1 << (entity->rarity - 1)) * 2.5;
+                else
+                    charges += 1;
             }
         }
 
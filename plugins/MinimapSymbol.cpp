@@ -47,6 +47,19 @@ public:
     }
 };
 
+enum SymbolType {
+    SYMBOL_ENTITY,
+    SYMBOL_DELVE_CHEST,
+    SYMBOL_HEIST_CHEST,
+};
+
+struct Symbol {
+    Entity* entity;
+    int type;
+    int index;      /* texture index of an entity, color of a delve chest */
+    int size;
+};
+
 class MinimapSymbol : public PoEPlugin {
 public:
 
@@ -66,6 +79,12 @@ public:
     bool show_packs = false;
     std::vector<MonsterPack> monster_packs;
 
+    // symbols and chests of the tick in entity order, projected together after the
+    // entity loop
+    std::vector<Symbol> symbols;
+    std::vector<Vector3> positions, screen_positions;
+    std::vector<Entity*> pack_monsters;
+
     // delve chests
     bool show_delve_chests = true;
     std::wregex ignored_delve_chests;
@@ -92,14 +111,14 @@ public:
                              0xe0ffff,                                  // NPC
                              0xfe00fe};                                 // player
     
-    std::map<wstring, int> chest_colors = {{L"AzuriteVein", 0xff}, 
-                                           {L"Resonator", 0xff7f},
-                                           {L"Fossil", 0xffff},
-                                           {L"Currency", 0xffffff},
-                                           {L"Map", 0xffffff},
-                                           {L"SuppliesDynamite", 0x7f0000},
-                                           {L"SuppliesFlares", 0xff0000},
-                                           {L"Unique", 0xffff}};
+    std::vector<std::pair<int, int>> chest_colors = {{CATEGORY_AZURITE_VEIN, 0xff},
+                                                     {CATEGORY_CURRENCY, 0xffffff},
+                                                     {CATEGORY_FOSSIL, 0xffff},
+                                                     {CATEGORY_MAP, 0xffffff},
+                                                     {CATEGORY_RESONATOR, 0xff7f},
+                                                     {CATEGORY_SUPPLIES_DYNAMITE, 0x7f0000},
+                                                     {CATEGORY_SUPPLIES_FLARES, 0xff0000},
+                                                     {CATEGORY_UNIQUE, 0xffff}};
 
     MinimapSymbol() : PoEPlugin(L"MinimapSymbol", "0.11"),
         ignored_delve_chests(L"Armour|Weapon|Generic|NoDrops|Encounter"),
@@ -219,12 +238,57 @@ public:
 
     void draw_entity(Entity* e, int index, int size) {
         Render* render = e->get_component<Render>();
-        if (render) {
-            Vector3 pos = render->position();
-            pos.x = player_pos.x + (pos.x - player_pos.x) * scale;
-            pos.y = player_pos.y + (pos.y - player_pos.y) * scale;
-            pos.z = pos.z * scale;
-            poe->in_game_state->transform(pos);
+        if (render)
+            symbols.push_back({e, SYMBOL_ENTITY, index, size});
+    }
+
+    /* Projects the queued symbols and the pack monsters in one batch and draws them
+       in the order they were queued. */
+    void draw_symbols() {
+        EntityTable& table = poe->entities.table;
+
+        positions.clear();
+        pack_monsters.clear();
+        for (auto& s : symbols) {
+            Vector3 pos = table.positions[s.entity->slot];
+            if (s.type == SYMBOL_HEIST_CHEST) {
+                pos.z += 2 * pos.z;
+            } else {
+                pos.x = player_pos.x + (pos.x - player_pos.x) * scale;
+                pos.y = player_pos.y + (pos.y - player_pos.y) * scale;
+                pos.z = (s.type == SYMBOL_DELVE_CHEST) ? 0.0f : pos.z * scale;
+            }
+            positions.push_back(pos);
+        }
+
+        if (show_packs) {
+            for (auto& s : symbols) {
+                Entity* e = s.entity;
+                if (s.type == SYMBOL_ENTITY && e->is_monster && !e->is_neutral) {
+                    positions.push_back(table.positions[e->slot]);
+                    pack_monsters.push_back(e);
+                }
+            }
+        }
+
+        screen_positions.resize(positions.size());
+        poe->in_game_state->project_batch(positions.data(), positions.size(), screen_positions.data());
+
+        for (int i = 0; i < symbols.size(); ++i) {
+            Entity* e = symbols[i].entity;
+            int index = symbols[i].index;
+            int size = symbols[i].size;
+            Vector3& pos = screen_positions[i];
+
+            if (symbols[i].type == SYMBOL_DELVE_CHEST) {
+                draw_delve_chest(pos.x + shift_x, pos.y + shift_y, index);
+                continue;
+            }
+
+            if (symbols[i].type == SYMBOL_HEIST_CHEST) {
+                draw_heist_chest(e, pos.x, pos.y);
+                continue;
+            }
 
             int x = pos.x + shift_x;
             int y = pos.y + shift_y;
@@ -237,16 +301,25 @@ public:
                 if (e->rarity == 3)
                     poe->hud->draw_circle(x, y, size + 2, 0xff0000, 2);
             }
+        }
+
+        for (int i = 0; i < pack_monsters.size(); ++i) {
+            Entity* e = pack_monsters[i];
+            Vector3& pos = screen_positions[symbols.size() + i];
+            int x = pos.x, y = pos.y;
+            bool added = false;
 
-            if (show_packs && (e->is_monster && !e->is_neutral)) {
-                Point p = poe->get_pos(e);
-                for (auto& pack : monster_packs) {
-                    if (pack.add(e, p.x, p.y))
-                        return;
+            for (auto& pack : monster_packs) {
+                if (pack.add(e, x, y)) {
+                    added = true;
+                    break;
                 }
-                monster_packs.push_back(MonsterPack(e, p.x, p.y));
             }
+            if (!added)
+                monster_packs.push_back(MonsterPack(e, x, y));
         }
+
+        symbols.clear();
     }
 
     void draw_monster_packs() {
@@ -258,49 +331,40 @@ public:
         if (std::regex_search(e->path, ignored_delve_chests))
             return;
 
-        Targetable* targetable = e->get_component<Targetable>();
-        if (!targetable || !targetable->is_targetable())
+        if (!poe->entities.table.targetable[e->slot])
             return;
 
         Render* render = e->get_component<Render>();
         if (render) {
-            Vector3 pos = render->position();
-            pos.x = player_pos.x + (pos.x - player_pos.x) * scale;
-            pos.y = player_pos.y + (pos.y - player_pos.y) * scale;
-            pos.z = 0.0f;
-            poe->in_game_state->transform(pos);
-
             int color = 0x7f7f7f;
             for (auto& i : chest_colors) {
-                if (e->path.find(i.first) != string::npos) {
+                if (e->category & i.first) {
                     color = i.second;
                     break;
                 }
             }
-
-            pos.x += shift_x;
-            pos.y += shift_y;
-            poe->hud->fill_circle(pos.x, pos.y, min_size + 7, 0xffffff, 0.8);
-            poe->hud->fill_circle(pos.x, pos.y, min_size + 4, color, 0.8);
+            symbols.push_back({e, SYMBOL_DELVE_CHEST, color, 0});
         }
     }
 
+    void draw_delve_chest(float x, float y, int color) {
+        poe->hud->fill_circle(x, y, min_size + 7, 0xffffff, 0.8);
+        poe->hud->fill_circle(x, y, min_size + 4, color, 0.8);
+    }
+
     void draw_heist_chests(Entity* e) {
-        Targetable* targetable = e->get_component<Targetable>();
-        if (!targetable || !targetable->is_targetable())
+        if (!poe->entities.table.targetable[e->slot])
             return;
 
         Render* render = e->get_component<Render>();
-        if (render) {
-            Vector3 pos = render->position();
-            Vector3 bound = render->position();
-            pos.z += 2 * bound.z;
-            poe->in_game_state->transform(pos);
+        if (render)
+            symbols.push_back({e, SYMBOL_HEIST_CHEST, 0, 0});
+    }
 
-            std::wsmatch match;
-            if (std::regex_search(e->path, match, heist_regex) && match.size() > 0)
-                poe->hud->draw_text(match[2].str(), pos.x, pos.y, 0xffffff, 0xad1616, 1.0, 1);
-        }
+    void draw_heist_chest(Entity* e, float x, float y) {
+        std::wsmatch match;
+        if (std::regex_search(e->path, match, heist_regex) && match.size() > 0)
+            poe->hud->draw_text(match[2].str(), x, y, 0xffffff, 0xad1616, 1.0, 1);
     }
 
     void on_area_changed(AreaTemplate* world_area, int hash_code, LocalPlayer* player) {
@@ -316,9 +380,11 @@ public:
             return;
         }
 
+        EntityTable& table = poe->entities.table;
         poe->hud->begin_draw();
         poe->hud->clear();
         monster_packs.clear();
+        symbols.clear();
         initialize();
         for (auto& i : entities) {
             if (force_reset) {
@@ -332,12 +398,13 @@ public:
                 continue;
 
             Entity* entity = i.second.get();
-            if (entity->is_npc && !entity->is_dead()) {
+            bool is_dead = (table.life[entity->slot] == 0);
+            if (entity->is_npc && !is_dead) {
                 if (show_npc)
                     draw_entity(entity, 9, min_size + 2);
             } else if (entity->is_monster) {
                 if (show_monsters) {
-                    if (entity->is_dead()) {
+                    if (is_dead) {
                         if (show_corpses)
                             draw_entity(entity, 4 + entity->rarity, min_size + entity->rarity);
                         else
@@ -357,9 +424,9 @@ public:
                 if (show_player)
                     draw_entity(entity, 10, min_size + 4);
             } else if (entity->has_component("Chest")) {
-                if (show_delve_chests && entity->path.find(L"/DelveChests") != wstring::npos)
+                if (show_delve_chests && (entity->category & CATEGORY_DELVE_CHEST))
                     draw_delve_chests(entity);
-                else if (show_heist_chests && entity->path.find(L"/HeistChest") != wstring::npos)
+                else if (show_heist_chests && (entity->category & CATEGORY_HEIST_CHEST))
                     draw_heist_chests(entity);
                 else
                     ignored_entities.insert(i.second->id);
@@ -368,6 +435,7 @@ public:
             }
         }
 
+        draw_symbols();
         if (show_packs) {
             draw_monster_packs();
             monster_packs.clear();